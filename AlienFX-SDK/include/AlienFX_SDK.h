@@ -2,8 +2,23 @@
 #include <hidapi_libusb.h>
 #include <libusb.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -34,16 +49,53 @@ namespace AlienFX_SDK {
 #define ALIENFX_FLAG_INDICATOR \
     2  // This is indicator light (keep at lights off)
 
+// Mappings sections, used to mark changed parts for saving:
+#define ALIENFX_MAP_DEVICES 1  // device names, white balance, brightness
+#define ALIENFX_MAP_LIGHTS 2   // light names, flags and scancodes
+#define ALIENFX_MAP_GROUPS 4   // light groups
+#define ALIENFX_MAP_GRIDS 8    // grid zones
+#define ALIENFX_MAP_ALL 0xf
+
 // Maximal buffer size across all device types
 #define MAX_BUFFERSIZE 193
 
+// Encoded report flags:
+#define AFX_REPORT_FEATURE 1  // sent as feature report (v8 control commands)
+#define AFX_REPORT_WAIT 2     // device status was polled before report
+
 union Afx_colorcode  // Atomic color structure
 {
     struct {
         uint8_t b, g, r;
         uint8_t br;  // Brightness
     };
-    unsigned long ci;
+    uint32_t ci;
+};
+
+typedef uint32_t Afx_nameID;  // interned name ID, 0 for empty name
+
+// String pool for device, light, group and grid names. Each Mappings object
+// keeps one, so light structures only carry 4-byte name IDs.
+class Afx_names {
+   private:
+    std::deque<std::string> strings;  // stable storage for index keys
+    std::unordered_map<std::string_view, Afx_nameID> index;
+
+   public:
+    Afx_names() { Clear(); }
+    Afx_names(Afx_names&&) = default;
+    Afx_names& operator=(Afx_names&&) = default;
+
+    // Get ID for the name, adding it to the pool if new
+    Afx_nameID Intern(std::string_view name);
+
+    // Get name by ID, empty string for unknown IDs
+    const std::string& Get(Afx_nameID id) const {
+        return id < strings.size() ? strings[id] : strings.front();
+    }
+
+    // Remove all names except the empty one
+    void Clear();
 };
 
 struct Afx_icommand {
@@ -57,21 +109,21 @@ struct Afx_light {  // Light information block
             unsigned short flags;
             unsigned short scancode;
         };
-        unsigned long data;
+        uint32_t data;
     };
-    std::string name;
+    Afx_nameID nameid;  // light name in Mappings::names
 };
 
 union Afx_groupLight {
     struct {
         unsigned short did, lid;
     };
-    unsigned long lgh;
+    uint32_t lgh;
 };
 
 struct Afx_group {  // Light group information block
-    unsigned long gid;
-    std::string name;
+    uint32_t gid;
+    Afx_nameID nameid;  // group name in Mappings::names
     std::vector<Afx_groupLight> lights;
 };
 enum Afx_Version {
@@ -92,22 +144,23 @@ struct Afx_device {  // Single device data
         struct {
             unsigned short pid, vid;  // IDs
         };
-        unsigned long devID;
+        uint32_t devID;
     };
     Functions* dev = nullptr;               // device control object pointer
-    std::string name;                       // device name
+    Afx_nameID nameid = 0;                  // device name in Mappings::names
     int version = API_UNKNOWN;              // API version used for this device
     Afx_colorcode white = {255, 255, 255};  // white balance
     uint8_t brightness = 255;               // global device brightness
     std::vector<Afx_light> lights;          // vector of lights defined
     bool arrived = false,
          present = false;  // for newly arrived and present devices
+    std::string path;      // HID path device was last seen at
 };
 
 struct Afx_grid {
     uint8_t id;
     uint8_t x, y;
-    std::string name;
+    Afx_nameID nameid;  // grid name in Mappings::names
     Afx_groupLight* grid;
 };
 
@@ -118,11 +171,113 @@ struct Afx_action {   // atomic light action phase
     uint8_t r, g, b;  // phase color
 };
 
+// Action phases list with inline storage for up to 3 phases (APIv4 record
+// limit), so common light blocks need no heap allocation. Longer lists are
+// moved to heap. Vector-like interface kept for compatibility.
+class Afx_actions {
+   private:
+    static constexpr uint8_t inlineSize = 3;
+    uint8_t count = 0, capacity = inlineSize;
+    union {
+        Afx_action inl[inlineSize];
+        uint8_t heap[sizeof(Afx_action*)];  // unaligned heap pointer
+    };
+
+    Afx_action* heapPtr() const {
+        Afx_action* p;
+        memcpy(&p, heap, sizeof(p));
+        return p;
+    }
+    void assign(const Afx_action* src, size_t n) {
+        reserve(n);
+        memcpy(data(), src, n * sizeof(Afx_action));
+        count = (uint8_t)n;
+    }
+
+   public:
+    typedef Afx_action value_type;
+    typedef Afx_action* iterator;
+    typedef const Afx_action* const_iterator;
+
+    Afx_actions() {}
+    Afx_actions(std::initializer_list<Afx_action> l) { assign(l.begin(), l.size()); }
+    Afx_actions(const std::vector<Afx_action>& v) { assign(v.data(), v.size()); }
+    Afx_actions(const Afx_actions& o) { assign(o.data(), o.count); }
+    Afx_actions(Afx_actions&& o) noexcept {
+        memcpy((void*)this, (void*)&o, sizeof(Afx_actions));
+        o.count = 0;
+        o.capacity = inlineSize;
+    }
+    Afx_actions& operator=(const Afx_actions& o) {
+        if (this != &o) assign(o.data(), o.count);
+        return *this;
+    }
+    Afx_actions& operator=(Afx_actions&& o) noexcept {
+        if (this != &o) {
+            this->~Afx_actions();
+            new (this) Afx_actions(std::move(o));
+        }
+        return *this;
+    }
+    ~Afx_actions() {
+        if (capacity > inlineSize) delete[] heapPtr();
+    }
+    operator std::vector<Afx_action>() const { return {begin(), end()}; }
+
+    Afx_action* data() { return capacity > inlineSize ? heapPtr() : inl; }
+    const Afx_action* data() const {
+        return capacity > inlineSize ? heapPtr() : inl;
+    }
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+    iterator begin() { return data(); }
+    iterator end() { return data() + count; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + count; }
+    Afx_action& front() { return data()[0]; }
+    Afx_action& back() { return data()[count - 1]; }
+    const Afx_action& front() const { return data()[0]; }
+    const Afx_action& back() const { return data()[count - 1]; }
+    Afx_action& operator[](size_t i) { return data()[i]; }
+    const Afx_action& operator[](size_t i) const { return data()[i]; }
+    Afx_action& at(size_t i) {
+        if (i >= count) throw std::out_of_range("Afx_actions");
+        return data()[i];
+    }
+    const Afx_action& at(size_t i) const {
+        if (i >= count) throw std::out_of_range("Afx_actions");
+        return data()[i];
+    }
+    void clear() { count = 0; }
+    void reserve(size_t n) {
+        if (n <= capacity) return;
+        if (n > 0xff) throw std::length_error("Afx_actions");
+        Afx_action* p = new Afx_action[n];
+        memcpy(p, data(), count * sizeof(Afx_action));
+        if (capacity > inlineSize) delete[] heapPtr();
+        memcpy(heap, &p, sizeof(p));
+        capacity = (uint8_t)n;
+    }
+    void push_back(const Afx_action& a) {
+        if (count == 0xff) throw std::length_error("Afx_actions");
+        if (count == capacity) reserve(capacity * 2 > 0xff ? 0xff : capacity * 2);
+        data()[count++] = a;
+    }
+    void pop_back() { count--; }
+};
+
 struct Afx_lightblock {  // light action block
     uint8_t index;
-    std::vector<Afx_action> act;
+    Afx_actions act;
 };
 
+// Data model layout checks - colors and light references are 4-byte words
+static_assert(sizeof(Afx_colorcode) == 4);
+static_assert(sizeof(Afx_groupLight) == 4);
+static_assert(sizeof(Afx_action) == 6);
+static_assert(sizeof(Afx_lightblock) <= 24);
+static_assert(sizeof(Afx_light) == 12);
+
 enum Action {
     AlienFX_A_Color = 0,
     AlienFX_A_Pulse = 1,
@@ -133,6 +288,11 @@ enum Action {
     AlienFX_A_Power = 6
 };
 
+struct Afx_report {  // Encoded HID report, as captured by dry run
+    std::vector<uint8_t> data;
+    uint8_t flags = 0;  // AFX_REPORT_* flags
+};
+
 class Functions {
    private:
     hid_device* devHandle = nullptr;  // USB device handle, NULL if not
@@ -141,8 +301,13 @@ class Functions {
     bool inSet = false;
 
     int length = -1;    // HID report length
+    bool simulated = false;  // no hardware, reports are only counted
     uint8_t chain = 1;  // seq. number for APIv1-v3
 
+    // Reports are stored here instead of sending while set (dry run)
+    std::vector<Afx_report>* capture = nullptr;
+    bool captureWait = false;  // status polled since last captured report
+
     // support function for mask-based devices (v1-v3, v6)
     vector<Afx_icommand>* SetMaskAndColor(vector<Afx_icommand>* mods,
                                           Afx_lightblock* act,
@@ -154,6 +319,9 @@ class Functions {
     bool PrepareAndSend(const uint8_t* command,
                         vector<Afx_icommand>* mods = NULL);
 
+    // Write prepared report to device, buffer can be overwritten by reply
+    bool SendReport(uint8_t* buffer, bool feature);
+
     // Add new light effect block for v8
     inline void AddV8DataBlock(uint8_t bPos, vector<Afx_icommand>* mods,
                                Afx_lightblock* act);
@@ -182,14 +350,18 @@ class Functions {
     union {
         struct {
             unsigned short pid, vid;  // Device IDs
-            char* path;               // Device path
         };
-        unsigned long devID;
+        uint32_t devID;
     };
+    std::string path;           // Device path
     int version = API_UNKNOWN;  // interface version, will stay at API_UNKNOWN
                                 // if not initialized
     uint8_t bright = 64;        // Last brightness set for device
     string description;         // device description
+    unsigned long reports = 0;  // HID reports sent to device
+    // If set, receives steady clock time (us) of the next report sent, then
+    // is reset. For report latency measurement.
+    uint64_t* reportStamp = nullptr;
 
     // Functions(libusb_context *ctxx) : ctx(ctxx) {};
     ~Functions();
@@ -207,6 +379,11 @@ class Functions {
     bool AlienFXProbeDevice(libusb_context* ctxx, unsigned short vidd = 0,
                             unsigned short pidd = 0, char* pathh = 0);
 
+    // Set up simulated device of given API version without hardware: reports
+    // are encoded and counted, but not sent, and device is always ready. For
+    // benchmarks and binding tests. Returns false for unknown version.
+    bool AlienFXSimulate(unsigned short vidd, unsigned short pidd, int ver);
+
     // Prepare to set lights
     bool Reset();
 
@@ -262,13 +439,59 @@ class Functions {
 
     // check global effects availability
     bool IsHaveGlobal();
+
+    // HID report length, -1 if device is not initialized
+    int GetLength() const { return length; }
+
+    // Run encoder calls without sending anything to device. Reports built
+    // by fn are returned instead, status polls are skipped, device state is
+    // restored after. Device should not be used by other threads meanwhile.
+    std::vector<Afx_report> DryRun(const std::function<void(Functions*)>& fn);
+
+    // Send reports captured by DryRun as is, waiting for device where status
+    // was polled. Reports should be captured for the same device type.
+    bool Replay(const std::vector<Afx_report>& reps);
 };
 
+struct Afx_mapCache;
+struct Afx_mapData;
+
 class Mappings {
    private:
     std::vector<Afx_group> groups;  // Defined light groups
     std::vector<Afx_grid> grids;    // Grid zones info
     libusb_context* ctx = nullptr;
+
+    // debounced saving
+    std::unique_ptr<Afx_mapCache> cache;  // serialized sections
+    std::thread saveThread;
+    std::mutex saveLock;
+    std::mutex writeLock;  // one file write at a time (writer thread, Flush)
+    std::condition_variable saveCond;
+    int dirty = 0;               // ALIENFX_MAP_* sections changed since save
+    bool saveStop = false;       // stop writer thread
+    std::string saveUser;        // user name for mappings path
+    bool keepFile = false;       // file has newer schema, never overwritten
+    std::chrono::steady_clock::time_point lastChange;
+
+    // mappings file watch
+    std::thread watchThread;
+    int watchFd = -1,         // inotify descriptor
+        watchStop = -1;       // eventfd to stop watch thread
+    std::string watchUser;    // user name for watched mappings
+    std::atomic<unsigned> selfWrites{0};  // own writes to skip at watch
+    std::vector<Afx_device> fileDevs;  // merged devices or light lists that
+                                       // move memory, for ApplyMerged
+
+    // writer thread body
+    void SaveLoop();
+    // watch thread body
+    void WatchLoop();
+    // merge reloaded mappings into live structures
+    void MergeMappings(Afx_mapData& m);
+    // serialize changed sections and write them into file
+    bool WriteMappings(int sections);
+
     // helper functions
     static std::filesystem::path GetMappingsPath(
         const char* username = nullptr);
@@ -276,9 +499,22 @@ class Mappings {
 
    public:
     vector<Afx_device> fxdevs;  // main devices/mappings array
+    Afx_names names;  // device, light, group and grid names, hold mapLock
+                      // while using it if watch is active
     unsigned activeLights = 0,  // total number of active lights into the system
         activeDevices = 0;      // total number of active devices
     bool deviceListChanged = false;  // Is list changed after last device scan?
+    std::vector<Functions*> released;  // handles of removed or replugged
+                                       // devices, delete them after their
+                                       // users (engine senders) are stopped
+    unsigned saveDelay = 500;  // debounce delay for MarkDirty() saving, ms
+    unsigned layoutGen = 0;  // bumped under mapLock when groups or grids are
+                             // replaced or edited, for layout caches
+    std::recursive_mutex mapLock;  // hold it while changing mappings if
+                                   // debounced saving or watch is active
+    std::function<void(int)> onReload;  // called from watch thread after
+                                        // external changes are merged, with
+                                        // ALIENFX_MAP_* sections updated
 
     Mappings();
     ~Mappings();
@@ -286,17 +522,45 @@ class Mappings {
     // Update device info after it found into the system
     void AlienFxUpdateDevice(Functions* dev);
 
-    // Enumerate all alienware devices into the system
+    // Enumerate all alienware devices into the system. Handles of devices
+    // gone or found at new path are moved to released.
     // acc - link to AlienFan_SDK::Control object for ACPI lights
     // returns true if light device list was changed
     bool AlienFXEnumDevices(void* acc = NULL);
 
+    // External edits merged by watch thread which add devices or change
+    // light lists wait, as they move device and light structures. Apply
+    // them when no other thread holds such pointers (enumeration does it
+    // too). MergePending is true if there are any, ApplyMerged returns true
+    // if anything was applied.
+    bool MergePending();
+    bool ApplyMerged();
+
     // load light names from a path
     void LoadMappings(const char* username = nullptr);
 
-    // save light names into a path
+    // save light names into a path (immediately, whole file)
     void SaveMappings(const char* username = nullptr);
 
+    // Mark mappings sections as changed and schedule saving.
+    // sections - ALIENFX_MAP_* flags
+    // Changes made within saveDelay are coalesced into one write.
+    void MarkDirty(int sections, const char* username = nullptr);
+
+    // Write pending changes now, if any, or wait for write in progress.
+    // Don't hold mapLock while calling it (writes lock it after file lock).
+    // Returns false if write failed.
+    bool Flush();
+
+    // Start watching mappings file for external changes (CLI, hand edits).
+    // Changed names, groups and grids are merged into live structures in
+    // background, open device handles are kept. Grid arrays are replaced, so
+    // hold mapLock while using grid pointers. Returns false if watch failed.
+    bool WatchMappings(const char* username = nullptr);
+
+    // Stop mappings file watch
+    void StopWatch();
+
     // Set device brightness
     // dev - point to AFX device info
     // br - brightness level
@@ -319,18 +583,21 @@ class Mappings {
     // VID can be zero for any VID
     Afx_device* GetDeviceById(unsigned short pid, unsigned short vid = 0);
 
-    // get device by VID/PID unsigned long.
-    Afx_device* GetDeviceById(unsigned long devID);
+    // get device by packed VID/PID.
+    Afx_device* GetDeviceById(uint32_t devID);
+    Afx_device* GetDeviceById(unsigned long devID) {
+        return GetDeviceById((uint32_t)devID);
+    }
 
     // get or add device structure by PID/VID
     // VID can be zero for any VID
-    Afx_device* AddDeviceById(unsigned long devID);
+    Afx_device* AddDeviceById(uint32_t devID);
 
     // find light mapping into device structure by light ID
     Afx_light* GetMappingByDev(Afx_device* dev, unsigned short LightID);
 
     // find light group by it's ID
-    Afx_group* GetGroupById(unsigned long gid);
+    Afx_group* GetGroupById(uint32_t gid);
 
     // remove light mapping from device by id
     void RemoveMapping(Afx_device* dev, unsigned short lightID);
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Audio visualizer modes:
+#define AFX_AUDIO_BARS 0   // level bars, grid columns from bottom
+#define AFX_AUDIO_PULSE 1  // whole column brightness and color by level
+
+struct Afx_audioParams {  // Audio visualizer parameters
+    uint8_t gridID = 0;
+    int mode = AFX_AUDIO_BARS;
+    Afx_colorcode low{0, 255, 0},  // color for low level (bar bottom)
+        high{0, 0, 255};           // color for high level (bar top)
+    float minFreq = 40,     // frequency of first grid column, Hz
+        maxFreq = 16000,    // frequency of last grid column, Hz
+        floorDb = -60;      // level shown as empty column, dB
+    unsigned decay = 300;   // bar fall time from full to empty, ms
+    unsigned fftSize = 1024;  // samples per FFT window, power of 2
+};
+
+struct Afx_audioStats {    // Audio processing statistics
+    unsigned blocks = 0;   // spectrums computed
+    unsigned overruns = 0;  // spectrums replaced before rendering
+    double fftTime = 0;    // average FFT and spectrum time, us
+};
+
+// Spectrum visualizer over mappings grid. Reads 16-bit PCM (raw or WAV)
+// from file, pipe or stdin, runs Hann-windowed FFT every half window and
+// renders log-spaced frequency bands into grid columns. Add one object to
+// engine for every device at the grid. Frames carry audio capture time, so
+// Engine::GetStats reports audio to report latency (srcLatAvg).
+class Afx_audio : public Afx_effect {
+   private:
+    Mappings* map;
+    Afx_audioParams params;
+    unsigned rate = 48000, channels = 2;
+
+    // source reader
+    int fd = -1, stopFd = -1;
+    bool realtime = false;         // pace file reading to sample rate
+    std::vector<uint8_t> pending;  // bytes read ahead with format probe
+    std::thread reader;
+
+    // FFT state, reader thread only
+    unsigned n, bits;
+    std::vector<float> window, ring, re, im, twRe, twIm;
+    std::vector<uint32_t> rev;
+    size_t ringPos = 0, fresh = 0;  // ring write position, new samples
+
+    // spectrum shared with renderer
+    std::mutex lock;
+    std::vector<float> spectrum;  // bin levels, 0..1
+    uint64_t specTime = 0;        // capture time of spectrum samples, us
+    bool specNew = false;
+    Afx_audioStats stats;
+    double fftSum = 0;
+
+    // renderer state
+    std::vector<float> bars;  // column levels shown
+    uint64_t barTime = 0, barSource = 0;
+
+    // Parse WAV header if stream has one
+    bool ReadHeader();
+    void ReadLoop();
+    // FFT of last window, publish spectrum captured at time (us)
+    void Analyze(uint64_t time);
+
+   public:
+    Afx_audio(Mappings* map, const Afx_audioParams& params);
+    ~Afx_audio();
+
+    // Start reading PCM from file ("-" for stdin). WAV files set format from
+    // header, raw streams use rate and channels. Files are read at playback
+    // speed if realtime is set, as fast as possible otherwise.
+    bool Open(const char* path, unsigned rate = 48000, unsigned channels = 2,
+              bool realtime = true);
+
+    // Stop reading
+    void Close();
+
+    // Feed interleaved samples directly, instead of Open
+    // time - capture time of the last sample (Engine::Now clock)
+    void Push(const int16_t* samples, size_t frames, uint64_t time);
+
+    Afx_audioStats GetStats();
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
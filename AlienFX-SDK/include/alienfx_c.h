@@ -0,0 +1,110 @@
+#pragma once
+/* Stable C interface of AlienFX SDK, exported by shared library `alienfx`
+ * (built with -DALIENFX_BUILD_SHARED=ON) for bindings (Python, Rust, Go).
+ * Only plain C types cross the interface. Structures returned to caller
+ * start with their size, set by caller, so new fields can be added at the
+ * end without breaking old binaries.
+ * A context is not thread-safe: calls with the same context must not run
+ * concurrently. Different contexts are independent. */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(ALIENFX_C_EXPORTS)
+#define AFX_C_API __attribute__((visibility("default")))
+#else
+#define AFX_C_API
+#endif
+
+/* Bumped when functions are added, existing ones never change */
+#define AFX_C_API_VERSION 1
+
+/* Return codes */
+#define AFX_OK 0
+#define AFX_ERR_ARG -1     /* bad context, device index or buffer */
+#define AFX_ERR_DEVICE -2  /* device not present */
+#define AFX_ERR_IO -3      /* device rejected report */
+
+/* Device capabilities */
+#define AFX_CAP_COLOR 0x1       /* per-light colors */
+#define AFX_CAP_ACTIONS 0x2     /* per-light hardware effects (not v5) */
+#define AFX_CAP_GLOBAL 0x4      /* global hardware effects (v5, v8) */
+#define AFX_CAP_BRIGHTNESS 0x8  /* hardware brightness (not v6) */
+#define AFX_CAP_SIMULATED 0x10  /* no hardware, reports are only counted */
+
+/* Light flags, as in mappings */
+#define AFX_LIGHT_POWER 0x1      /* power button */
+#define AFX_LIGHT_INDICATOR 0x2  /* indicator, kept on at lights off */
+
+typedef struct afx_context afx_context;
+
+typedef struct afx_device_info {
+    uint32_t size;         /* sizeof(afx_device_info), set by caller */
+    uint32_t dev_id;       /* packed PID (low) and VID (high) */
+    uint16_t vid, pid;
+    int32_t api_version;   /* 2..8, -1 unknown */
+    int32_t report_length; /* HID report length, bytes */
+    uint32_t lights;       /* mapped lights */
+    uint32_t caps;         /* AFX_CAP_* */
+    int32_t present;       /* device is connected */
+    uint64_t reports;      /* HID reports sent */
+    char name[64];         /* user-given or device name, 0-terminated */
+} afx_device_info;
+
+typedef struct afx_light_info {
+    uint32_t size;   /* sizeof(afx_light_info), set by caller */
+    uint32_t id;     /* light ID, index in frame buffers */
+    uint32_t flags;  /* AFX_LIGHT_* */
+    uint32_t scancode;
+    char name[64];   /* 0-terminated */
+} afx_light_info;
+
+/* Interface version of loaded library, AFX_C_API_VERSION it was built with */
+AFX_C_API int afx_api_version(void);
+
+/* Load mappings and open present devices, NULL on failure */
+AFX_C_API afx_context* afx_open(void);
+
+/* Context with one simulated device (no hardware, mappings untouched):
+ * dev_id - packed PID/VID to report, api_version - 2..8,
+ * lights - lights with IDs 0..lights-1. NULL for bad arguments. */
+AFX_C_API afx_context* afx_open_simulated(uint32_t dev_id, int api_version,
+                                          unsigned lights);
+
+/* Close devices and free context */
+AFX_C_API void afx_close(afx_context* ctx);
+
+/* Scan for plugged in or removed devices. Returns 1 if device list
+ * changed, 0 if not, or error. Device indexes stay valid. */
+AFX_C_API int afx_rescan(afx_context* ctx);
+
+/* Number of known devices (present or not), or error */
+AFX_C_API int afx_device_count(afx_context* ctx);
+
+/* Fill device information for device index 0..count-1 */
+AFX_C_API int afx_get_device_info(afx_context* ctx, int dev,
+                                  afx_device_info* info);
+
+/* Fill light information, light - index 0..info.lights-1 */
+AFX_C_API int afx_get_light_info(afx_context* ctx, int dev, int light,
+                                 afx_light_info* info);
+
+/* Show frame of packed RGB colors on device without copying it.
+ * rgb - count colors for light IDs 0..count-1, read in place
+ * stride - bytes from one color to the next (3 for packed RGB, 4 for
+ * RGBA/RGBX), 0 - 3
+ * Only lights changed since the previous frame are encoded, power button
+ * lights are skipped. The call returns when reports are sent. */
+AFX_C_API int afx_submit_rgb(afx_context* ctx, int dev, const uint8_t* rgb,
+                             unsigned count, unsigned stride);
+
+/* Set hardware brightness, 0..255. Power lights keep their colors.
+ * Devices needing colors after turning on get them with the next frame. */
+AFX_C_API int afx_set_brightness(afx_context* ctx, int dev,
+                                 uint8_t brightness);
+
+#ifdef __cplusplus
+}
+#endif
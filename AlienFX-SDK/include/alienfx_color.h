@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "AlienFX_SDK.h"
+
+namespace AlienFX_SDK {
+
+// SIMD levels for color processing
+#define AFX_SIMD_NONE 0
+#define AFX_SIMD_SSE2 1
+#define AFX_SIMD_AVX2 2
+
+// Color processing stage applied to light colors before encoding: gamma
+// correction, per-device white balance, optional brightness scale and
+// quantization to the color precision of device API (4 bit for V2/V3).
+// Only r, g and b are changed, br is kept as is.
+class Afx_colorPipe {
+   private:
+    uint32_t lut[3][256];  // combined per-channel tables, pre-shifted
+    uint16_t scale[4];     // fixed point b, g, r multipliers (256 = 1.0)
+    uint8_t quantAdd = 0,  // rounding for quantization
+        quantMask = 0xff;  // channel bits kept by device
+    bool linear = true;    // no gamma, LUT can be skipped
+    // parameters tables are built for
+    uint32_t white = 0xffffffff;
+    uint8_t brightness = 255;
+    int version = -1;
+    float gamma = 1.0f;
+
+   public:
+    int simd;  // SIMD level used, can be lowered for testing
+
+    Afx_colorPipe() : simd(Detect()) { Setup({255, 255, 255}, 255, -1); }
+
+    // Build tables for new parameters
+    // white - white balance, brightness - global brightness (255 - full)
+    // version - device API version, gamma - gamma exponent (1 - off)
+    void Setup(Afx_colorcode white, uint8_t brightness, int version,
+               float gamma = 1.0f);
+
+    // Rebuild tables if device settings changed since last call.
+    // Device brightness is not applied, every API dims in hardware (V6/V7
+    // send it with each color), scaling here would dim twice.
+    void Update(const Afx_device* dev, float gamma = 1.0f) {
+        if (dev->white.ci != white || brightness != 255 ||
+            dev->version != version || gamma != this->gamma)
+            Setup(dev->white, 255, dev->version, gamma);
+    }
+
+    // Process colors in place
+    void Apply(Afx_colorcode* colors, size_t count) const;
+
+    // Best SIMD level supported by CPU
+    static int Detect();
+};
+
+}  // namespace AlienFX_SDK
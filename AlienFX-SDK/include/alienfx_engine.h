@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AlienFX_SDK.h"
+#include "alienfx_color.h"
+
+namespace AlienFX_SDK {
+
+// Maximal lights per device frame (light IDs are 8 bit)
+#define AFX_FRAME_LIGHTS 256
+
+struct Afx_frame {  // Per-device frame buffer
+    // light colors, indexed by light ID. br is light coverage - 0 if light is
+    // not set in this frame, 255 for fully set light
+    Afx_colorcode lights[AFX_FRAME_LIGHTS];
+    uint64_t stamp = 0;   // render start time, us (steady clock)
+    uint64_t source = 0;  // earliest input time frame content is based on,
+                          // us (0 - no input), set by effects
+
+    // Clear all lights to unset state
+    void Clear() { memset(lights, 0, sizeof(lights)); }
+
+    // Set light color
+    void Set(uint8_t lid, uint8_t r, uint8_t g, uint8_t b) {
+        lights[lid] = {b, g, r, 255};
+    }
+};
+
+class Afx_effect {  // Software effect, rendered by Engine every frame
+   public:
+    virtual ~Afx_effect() = default;
+
+    // Render effect into device frame.
+    // dev - device to render for
+    // frame - device frame, other effects can be rendered into it already
+    // t - time from effect start, us
+    // Returns false if effect is finished and should be removed.
+    virtual bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) = 0;
+};
+
+struct Afx_flash {  // Notification overlay
+    std::vector<Afx_groupLight> lights;  // device PID and light ID, as in
+                                         // groups
+    Afx_colorcode color{0, 0, 255, 255};
+    unsigned on = 200, off = 200;  // flash and pause, ms
+    unsigned count = 3;            // flashes, 0 - until cancelled
+};
+
+struct Afx_engineStats {     // Frame statistics for device
+    unsigned frames = 0;     // frames processed by device sender
+    unsigned dropped = 0;    // frames replaced before sending (back-pressure)
+    unsigned reports = 0;    // frames which need USB update
+    double fps = 0;          // achieved frames per second, last second
+    double latAvg = 0,       // frame latency (render to update done), ms
+        latMax = 0,          // maximal latency, last second
+        srcLatAvg = 0,       // input to update done latency, ms, for frames
+        srcLatMax = 0;       // with source time
+    unsigned overlays = 0;   // overlays shown
+    double overlayLatAvg = 0,  // Flash call to first report sent, ms
+        overlayLatMax = 0;
+};
+
+struct Afx_engineDev;
+
+class Engine {  // Fixed-rate software effects scheduler
+   private:
+    Mappings* map;
+    unsigned fps;
+    int timerFd = -1,  // timerfd for frame ticks
+        sentFd = -1,   // eventfd signalled by senders after every frame
+        stopFd = -1,   // eventfd to stop scheduler thread
+        epollFd = -1;  // timer and senders, for external loop
+    std::thread tickThread;
+    std::recursive_mutex lock;  // effects and devices lock
+
+    struct Afx_engineEffect {
+        unsigned id;
+        uint32_t devID;
+        std::shared_ptr<Afx_effect> effect;
+        uint64_t start;  // us
+    };
+    std::vector<Afx_engineEffect> effects;
+
+    struct Afx_engineFlash {
+        unsigned id;
+        Afx_flash flash;
+        uint64_t start;     // us
+        bool cancel = false;
+        int lit = -1;          // phase: 0 - off, 1 - lit, 2 - ended,
+                               // -1 - not shown yet
+        bool first = false,    // first frame of overlay
+            changed = false;   // phase changed this frame
+        // lights by device and colors to restore (as sent, br 0 - unknown)
+        std::map<uint32_t, std::vector<std::pair<uint8_t, Afx_colorcode>>>
+            lights;
+    };
+    std::vector<Afx_engineFlash> flashes;
+    std::map<uint32_t, std::unique_ptr<Afx_engineDev>> devs;
+    unsigned nextID = 1;
+
+    // scheduler thread body
+    void TickLoop();
+    // device frame sender thread body
+    void SendLoop(Afx_engineDev* edev);
+    // get or create device state
+    Afx_engineDev* GetDev(uint32_t devID, Functions* dev);
+    // stop and join device sender, pending frame and calls are dropped
+    static void StopDev(Afx_engineDev* edev);
+    // draw overlays into rendered device frame, before and after color
+    // correction
+    void DrawFlashes(Afx_engineDev* edev, uint64_t now, bool corrected);
+
+   public:
+    // called from scheduler thread (Dispatch) when effect finished
+    std::function<void(unsigned id)> onEffectDone;
+    // called from scheduler thread (Dispatch) after device finished sending
+    // frame, to render next one at device pace
+    std::function<void(uint32_t devID)> onFrameSent;
+    // gamma correction for rendered colors, 1 - off. White balance and
+    // brightness from device mappings are always applied.
+    float gamma = 1.0f;
+
+    // map - devices and mappings to render for
+    // fps - target frame rate
+    Engine(Mappings* map, unsigned fps = 30);
+    ~Engine();
+
+    // Start scheduler. Devices used by effects should not be accessed by
+    // application while scheduler is running.
+    // thread - run scheduler thread, otherwise application polls Fd() in its
+    // own event loop and calls Dispatch(). Device senders are threads always.
+    bool Start(bool thread = true);
+
+    // Stop scheduler and device senders, pending frames are dropped
+    void Stop();
+
+    // Stop senders using device handle, before it is deleted. Next frame
+    // for the device starts a sender with its current handle.
+    void Release(Functions* dev);
+
+    // Descriptor readable when frame is due or device finished sending,
+    // for application event loop (epoll, poll, GUI toolkit). -1 if stopped.
+    int Fd() const { return epollFd; }
+
+    // Handle due frame and finished sends without blocking, calls Tick and
+    // callbacks. Returns false if engine is stopped.
+    bool Dispatch();
+
+    // Wait until device senders have no pending frames or calls, so the
+    // last rendered frame reaches devices before Stop
+    void Flush();
+
+    // Set target frame rate
+    void SetFPS(unsigned newFps);
+
+    // Add effect for device
+    // devID - packed VID/PID of device
+    // Returns effect ID
+    unsigned AddEffect(uint32_t devID, std::shared_ptr<Afx_effect> effect);
+
+    // Remove effect by ID
+    void RemoveEffect(unsigned id);
+
+    // Remove all effects
+    void ClearEffects();
+
+    // Render all effects and queue frames to device senders.
+    // Called by scheduler every frame, and can be called by application for
+    // out-of-schedule frame (to react on input without waiting for tick).
+    void Tick();
+
+    // Show notification overlay on top of effects: lights flash count times,
+    // then show effects (or colors sent before overlay, black if unknown)
+    // again. Overlay frame is rendered at once and sent ahead of queued
+    // calls, its lights first; the wait is bounded by the frame being sent.
+    // Returns overlay ID, 0 if no flash lights are present.
+    unsigned Flash(const Afx_flash& flash);
+
+    // End overlay, restoring its lights with the next frame
+    void CancelFlash(unsigned id);
+
+    // Any overlay is shown
+    bool Flashing();
+
+    // Queue call for device sender thread, so application can use device
+    // while engine is sending frames to it. Calls run in order, before the
+    // next frame. Returns false if device is not present.
+    bool Run(uint32_t devID, std::function<void(Functions*)> cmd);
+
+    // Get frame statistics for device
+    Afx_engineStats GetStats(uint32_t devID);
+
+    // current steady clock time, us
+    static uint64_t Now();
+};
+
+}  // namespace AlienFX_SDK
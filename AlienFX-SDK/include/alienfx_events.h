@@ -0,0 +1,126 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Event types, also subscription mask bits
+#define AFX_EVENT_DEVICE_ADDED 0x1    // device plugged in (devID)
+#define AFX_EVENT_DEVICE_REMOVED 0x2  // device unplugged (devID)
+#define AFX_EVENT_PROFILE 0x4         // platform profile changed (name)
+#define AFX_EVENT_SENSOR 0x8    // sensor crossed threshold (id, name, value)
+#define AFX_EVENT_EFFECT_DONE 0x10    // engine effect finished (id)
+#define AFX_EVENT_ALL 0x1f
+
+// Platform profile attribute, sysfs notifies pollers when it changes
+#define AFX_EVENT_PROFILE_PATH "/sys/firmware/acpi/platform_profile"
+// Hotplug events are coalesced for this time before devices are scanned, ms
+#define AFX_EVENT_SCAN_DELAY 300
+
+struct Afx_event {
+    int type = 0;        // AFX_EVENT_*
+    uint32_t devID = 0;  // device events
+    unsigned id = 0;     // sensor watch or effect ID
+    int value = 0;       // sensor value
+    bool above = false;  // sensor is at or above threshold now
+    std::string name;    // profile or sensor name
+};
+
+// Event as text line: type name, then tab-separated details
+std::string Afx_eventText(const Afx_event& ev);
+
+// Event bus: turns kernel hotplug messages, platform profile changes,
+// sensor readings and engine effect ends into events for subscribers, so
+// they can sleep instead of polling. Hotplug triggers a device scan
+// (Mappings::AlienFXEnumDevices), so device presence stays current too,
+// and frees handles of unplugged devices. Replugged device is removed, then
+// added.
+// Subscribers are called from event thread, or from Dispatch if bus runs
+// in application event loop.
+class Afx_events {
+   private:
+    struct Afx_sensorWatch {
+        unsigned id;
+        std::string name;
+        std::function<int()> read;
+        int threshold, hysteresis;
+        int state = -1;  // -1 - unknown, 0 - below, 1 - above
+    };
+    struct Afx_subscriber {
+        unsigned id;
+        int mask;  // AFX_EVENT_* types
+        std::function<void(const Afx_event&)> cb;
+    };
+    Mappings* map;
+    Engine* engine = nullptr;  // watched engine
+    std::thread thread;
+    int epollFd = -1,
+        stopFd = -1,     // eventfd to stop event thread
+        postFd = -1,     // eventfd signalled by Post
+        ueventFd = -1,   // kernel hotplug netlink socket
+        scanFd = -1,     // timerfd for coalesced device scan
+        sensorFd = -1,   // timerfd for sensor polls
+        profileFd = -1;  // platform profile attribute
+    std::mutex lock;     // subscribers, sensors and posted events
+    std::vector<Afx_subscriber> subs;
+    std::vector<Afx_sensorWatch> sensors;
+    std::deque<Afx_event> posted;
+    std::map<uint32_t, Functions*> present;  // device handles at last scan
+    std::string profile;
+    unsigned nextID = 1;
+
+    // event thread body, Dispatch when ready
+    void Loop();
+    void Emit(const Afx_event& ev);
+    void ReadUevents();
+    void Rescan();
+    void ReadProfile(bool notify);
+    void PollSensors();
+
+   public:
+    Afx_events(Mappings* map) : map(map) {}
+    ~Afx_events() { Stop(); }
+
+    // Open event sources and start event thread. Missing sources (no
+    // platform profile, no netlink access) are skipped.
+    // sensorPeriod - sensor poll period, ms
+    // thread - run event thread, otherwise application polls Fd() in its
+    // own event loop and calls Dispatch()
+    bool Start(unsigned sensorPeriod = 1000, bool thread = true);
+    void Stop();
+
+    // Descriptor readable when any source (hotplug, profile, sensor timer,
+    // posted events) is ready, -1 if stopped
+    int Fd() const { return epollFd; }
+
+    // Handle ready sources without blocking, subscribers are called from
+    // here. Returns false if bus is stopped.
+    bool Dispatch();
+
+    // Call cb for events of mask types, returns subscription ID
+    unsigned Subscribe(int mask, std::function<void(const Afx_event&)> cb);
+    void Unsubscribe(unsigned id);
+
+    // Poll sensor value with read and send event when it reaches threshold
+    // or drops below threshold - hysteresis. First reading only sets sensor
+    // state. Returns watch ID, sent as event ID.
+    unsigned WatchSensor(const std::string& name, std::function<int()> read,
+                         int threshold, int hysteresis = 2);
+    void UnwatchSensor(unsigned id);
+
+    // Send effect end events for engine (sets its onEffectDone, keeping the
+    // old handler), and stop its senders for unplugged devices
+    void WatchEngine(Engine* engine);
+
+    // Queue event for subscribers, from any thread
+    void Post(const Afx_event& ev);
+};
+
+}  // namespace AlienFX_SDK
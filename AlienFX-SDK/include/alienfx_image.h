@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+struct Afx_imageStats {   // Image stream statistics
+    unsigned frames = 0;   // images scaled
+    unsigned dropped = 0;  // images replaced before rendering
+    unsigned changed = 0;  // grid cells changed by last image
+    double scaleTime = 0;  // average downscale time, us
+};
+
+// Ambient lighting from stream of RGB images (screen capture, video). Images
+// are area-averaged down to grid size, one color per grid cell, and rendered
+// into lights under the cells. Engine applies device white balance and sends
+// changed lights only. Add one object to engine for every device at the grid.
+// Frames carry image arrival time, so Engine::GetStats reports image to report
+// latency (srcLatAvg).
+class Afx_imageStream : public Afx_effect {
+   private:
+    Mappings* map;
+    uint8_t gridID;
+
+    // source reader
+    int fd = -1, stopFd = -1;
+    unsigned rawW = 0, rawH = 0;  // raw stream image size, 0 - PPM
+    unsigned fps = 0;             // pacing for files, 0 - as fast as read
+    std::string pattern;          // file sequence name pattern
+    unsigned seqFirst = 0;
+    std::thread reader;
+    std::vector<uint8_t> image;   // image being read
+
+    // scaler state, reader thread only
+    unsigned gx = 0, gy = 0, imgW = 0, imgH = 0;
+    std::vector<unsigned> xb, yb;  // cell bounds in image pixels
+    std::vector<uint32_t> acc;     // per-channel sums of cell row band
+    std::vector<Afx_colorcode> scaled;
+
+    // cells shared with renderer
+    std::mutex lock;
+    std::vector<Afx_colorcode> cells;  // grid cell colors, row by row
+    uint64_t cellTime = 0;             // arrival time of cells image, us
+    bool cellNew = false;
+    Afx_imageStats stats;
+    double scaleSum = 0;
+    uint64_t renderStamp = 0, renderSource = 0;
+
+    // Read exactly len bytes, false on end of stream or stop
+    bool ReadFull(uint8_t* buf, size_t len);
+    // Read next PPM or raw image into image, false at end of stream
+    bool ReadImage(unsigned& w, unsigned& h);
+    // Wait until due time (us), false if stopped
+    bool WaitUntil(uint64_t due);
+    void ReadLoop();
+    void SequenceLoop();
+
+   public:
+    int simd;  // SIMD level used for downscale, can be lowered for testing
+
+    Afx_imageStream(Mappings* map, uint8_t gridID);
+    ~Afx_imageStream();
+
+    // Start reading images from file or pipe ("-" for stdin). Stream holds
+    // binary PPM (P6) images back to back, or raw RGB images of width x
+    // height if set. Regular files are played at fps.
+    bool Open(const char* path, unsigned width = 0, unsigned height = 0,
+              unsigned fps = 30);
+
+    // Start reading file sequence at fps. pattern is printf format with
+    // image number (frame%04d.ppm), sequence ends at first missing file.
+    bool OpenSequence(const char* pattern, unsigned fps = 30,
+                      unsigned first = 0);
+
+    // Stop reading
+    void Close();
+
+    // Downscale RGB image to grid and publish it, instead of Open
+    // stride - row size in bytes, time - image capture time (Engine::Now)
+    // Returns false if grid is not found.
+    bool Push(const uint8_t* rgb, unsigned width, unsigned height,
+              size_t stride, uint64_t time);
+
+    Afx_imageStats GetStats();
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,119 @@
+#pragma once
+#include <linux/input.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Reactive effect types:
+#define AFX_REACT_FLASH 0   // pressed key flashes and fades out
+#define AFX_REACT_RIPPLE 1  // ring moves out from pressed key over grid
+#define AFX_REACT_HEAT 2    // keys heat up with presses and cool down
+
+struct Afx_reactParams {  // Reactive effect parameters
+    int type = AFX_REACT_FLASH;
+    Afx_colorcode color{255, 255, 255};  // flash, ring or heat color
+    unsigned decay = 500;  // fade time, ms (heat: half-life)
+    float speed = 20,      // ripple speed, cells per second
+        width = 1.5f;      // ripple ring width, cells
+    uint8_t gridID = 0;    // grid for ripples
+};
+
+// Per-key reaction, rendered by engine. Add one object to engine for every
+// device it should work for, and to Afx_input to get key presses.
+class Afx_reactiveEffect : public Afx_effect {
+   private:
+    Mappings* map;
+    Afx_reactParams params;
+    std::mutex lock;  // presses and heat, triggered from input thread
+    struct Afx_press {
+        Afx_groupLight light;
+        uint64_t time;  // us
+    };
+    std::vector<Afx_press> presses;
+    std::unordered_map<uint32_t, float> heat;  // by light word
+    uint64_t heatTime = 0;                     // last heat decay time
+
+    void RenderRipples(Afx_device* dev, Afx_frame* frame);
+
+   public:
+    Afx_reactiveEffect(Mappings* map, const Afx_reactParams& params)
+        : map(map), params(params) {}
+
+    // Key with light pressed at time (Engine::Now clock)
+    void Trigger(Afx_groupLight light, uint64_t time);
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+struct Afx_inputStats {   // Keypress reaction statistics
+    unsigned presses = 0;  // key presses read
+    unsigned mapped = 0;   // presses of keys with lights
+    double latAvg = 0,     // key event to frame queued time, ms
+        latMax = 0;
+};
+
+// Reads key events from evdev devices and triggers reactive effects for
+// lights with matching scancode. Light scancodes are evdev key codes (KEY_*).
+// Engine renders and queues a frame right after each key event batch, out of
+// its schedule.
+class Afx_input {
+   private:
+    Mappings* map;
+    Engine* engine;
+    int epollFd = -1, stopFd = -1;
+    std::thread inputThread;
+    std::vector<int> fds;     // opened event sources
+    std::mutex lock;          // index, effects and stats lock
+    std::unordered_map<uint16_t, std::vector<Afx_groupLight>> keys;
+    std::vector<std::shared_ptr<Afx_reactiveEffect>> effects;
+    Afx_inputStats stats;
+    double latSum = 0;     // latency of frames rendered for key batches
+    uint64_t latCount = 0;
+
+    void InputLoop();
+
+   public:
+    Afx_input(Mappings* map, Engine* engine);
+    ~Afx_input();
+
+    // Rebuild scancode index from mappings, call after mappings changed
+    void BuildIndex();
+
+    // Start reading events from evdev device (/dev/input/eventN), uinput
+    // keyboards included
+    bool AddDevice(const char* path);
+
+    // Open all devices with keyboard keys
+    unsigned AddKeyboards();
+
+    // Start reading input_event records from any pollable descriptor (pipe,
+    // socket). Event times should use monotonic clock. Takes fd ownership.
+    bool AddFd(int fd);
+
+    // Feed recorded event stream from file, keeping recorded timing if
+    // realtime is set. Events are stamped with current time.
+    bool Replay(const char* path, bool realtime = true);
+
+    // Process key events batch, as read from device
+    void Process(const input_event* events, size_t count);
+
+    // Trigger effect by key presses
+    void AddEffect(std::shared_ptr<Afx_reactiveEffect> effect);
+    void ClearEffects();
+
+    Afx_inputStats GetStats();
+
+    // Stop reading and close devices
+    void Stop();
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,132 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace AlienFX_SDK {
+
+// Lighting daemon protocol over Unix stream socket. Request is one line of
+// tab-separated arguments (command line without program name). Reply is
+// command output, every line prefixed with '|', then status line "=<code>".
+// Connection can carry any number of requests. Descriptors can be sent
+// along with request (SCM_RIGHTS), e.g. to attach shared frame ring.
+// Daemon can push event lines "!<event>" to subscribed clients at any time
+// between replies.
+
+// Environment variable to override socket path
+#define AFX_IPC_ENV "ALIENFX_SOCKET"
+// System daemon socket (daemon running as root)
+#define AFX_IPC_SYSTEM "/run/alienfxd.sock"
+// Group allowed to use system daemon socket
+#define AFX_IPC_GROUP "alienfx"
+// Maximal request line length
+#define AFX_IPC_MAXLINE 65536
+// Maximal descriptors per request
+#define AFX_IPC_MAXFDS 4
+// Maximal output queued for slow client, it is dropped if exceeded
+#define AFX_IPC_MAXQUEUE (1 << 20)
+
+// Daemon socket path for current user: $ALIENFX_SOCKET, system socket for
+// root, $XDG_RUNTIME_DIR/alienfxd.sock (/tmp/alienfxd-<uid>.sock) otherwise
+std::string Afx_ipcPath();
+
+class Afx_ipcClient {  // Daemon connection
+   private:
+    int fd = -1;
+    std::string in;                 // reply data read ahead
+    std::deque<std::string> events;  // event lines read with replies
+
+   public:
+    ~Afx_ipcClient() { Close(); }
+
+    // Connect to daemon. Empty path tries user socket, then system one.
+    bool Connect(const std::string& path = "");
+    void Close();
+    bool Connected() const { return fd >= 0; }
+
+    // Run command at daemon
+    // args - command arguments, no tabs or line breaks
+    // out - command output, status - command exit code
+    // fds - descriptors to pass with request, up to AFX_IPC_MAXFDS
+    // Returns false if request can't be sent or reply is broken.
+    bool Request(const std::vector<std::string>& args, std::string& out,
+                 int& status, const std::vector<int>& fds = {});
+
+    // Take event pushed by daemon, waiting up to timeout ms (-1 - forever).
+    // False on timeout or closed connection.
+    bool ReadEvent(std::string& event, int timeout = -1);
+
+    // Socket to poll for events
+    int Fd() const { return fd; }
+};
+
+// Request handler: runs command, fills output, returns exit code
+typedef std::function<int(const std::vector<std::string>& args,
+                          std::string& out)>
+    Afx_ipcHandler;
+
+class Afx_ipcServer {  // Daemon socket listener
+   private:
+    struct Afx_ipcConn {
+        std::string in;        // unparsed input
+        std::string out;       // output socket didn't take yet
+        std::vector<int> fds;  // received descriptors, for next request
+        bool waiting = false;  // polled for output space
+    };
+    int listenFd = -1, epollFd = -1,
+        stopFd = -1;                   // eventfd to stop Run
+    std::string path;                  // socket path, removed at Close
+    std::map<int, Afx_ipcConn> conns;  // clients
+    std::map<int, std::function<void()>> watches;  // other polled fds
+    int client = -1;                   // connection of current request
+    std::vector<int> fds;              // descriptors of current request
+
+    void Drop(int fd);
+    void Read(int fd, const Afx_ipcHandler& handler);
+    // Queue output and send what socket takes without blocking, false if
+    // client should be dropped
+    bool Write(int fd, const std::string& data);
+    bool Flush(int fd);
+
+   public:
+    Afx_ipcServer();
+    ~Afx_ipcServer();
+
+    // Create socket. Fails if other daemon is listening at path, stale
+    // socket file is replaced. mode - socket file permissions, group -
+    // socket file group, -1 - keep.
+    bool Listen(const std::string& path, unsigned mode = 0600,
+                int group = -1);
+
+    // Serve clients until Stop, handler is called from this thread only
+    void Run(const Afx_ipcHandler& handler);
+
+    // Break Run, can be called from any thread or signal handler
+    void Stop();
+
+    // Close clients and remove socket
+    void Close();
+
+    // Called from Run when client disconnects, before its socket is closed
+    std::function<void(int client)> onClose;
+
+    // For handler: connection request came from
+    int Client() const { return client; }
+
+    // For handler: take descriptors sent with request. Descriptors not taken
+    // are closed when handler returns.
+    std::vector<int> TakeFds() { return std::move(fds); }
+
+    // Poll other descriptor in Run, cb is called when it is readable and
+    // should drain it. Call from handler or before Run.
+    bool AddWatch(int fd, std::function<void()> cb);
+    void RemoveWatch(int fd);
+
+    // Push event line to client, from handler or watch callback. Never
+    // blocks, client lagging more than AFX_IPC_MAXQUEUE bytes is dropped.
+    bool Send(int client, const std::string& event);
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,102 @@
+#pragma once
+#include <bitset>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Layer blend modes, layer light br is its opacity
+#define AFX_BLEND_NORMAL 0    // over lower layers
+#define AFX_BLEND_ADD 1       // add to lower layers, saturated
+#define AFX_BLEND_MULTIPLY 2  // filter lower layers
+#define AFX_BLEND_MAX 3       // brightest channel wins
+#define AFX_BLEND_COUNT 4
+
+typedef std::bitset<AFX_FRAME_LIGHTS> Afx_lightSet;
+
+struct Afx_compositorStats {  // Compositor statistics
+    unsigned frames = 0;      // device frames rendered
+    unsigned recomputed = 0;  // lights composed again
+};
+
+// Composes layers into one frame per device, lowest priority first. Each
+// layer has its own light colors (set directly or rendered by source
+// effect every frame) and an optional mask of lights it may change. Only
+// lights changed by layers, their masks, priorities or blend modes are
+// composed again, the rest comes from previous frame. Lights composed once
+// stay in frame (black if no layer covers them any more), so a removed
+// layer does not leave its colors on device.
+class Afx_compositor : public Afx_effect {
+   private:
+    struct Afx_layerDev {                  // layer content for device
+        Afx_colorcode lights[AFX_FRAME_LIGHTS]{};
+        Afx_lightSet set;                  // lights with br != 0
+        Afx_lightSet mask;                 // valid if layer is masked
+        std::shared_ptr<Afx_effect> source;
+        uint64_t start = 0;                // source start time, us
+    };
+    struct Afx_layer {
+        unsigned id;
+        int priority;
+        int blend;
+        bool masked = false;
+        std::map<uint32_t, Afx_layerDev> devs;
+    };
+    struct Afx_compDev {  // composed device frame
+        Afx_colorcode out[AFX_FRAME_LIGHTS]{};
+        Afx_lightSet dirty, owned;
+    };
+    Mappings* map;
+    std::mutex lock;
+    std::vector<Afx_layer> layers;  // by priority, then creation
+    std::map<uint32_t, Afx_compDev> comp;
+    unsigned nextID = 1;
+    Afx_compositorStats stats;
+
+    Afx_layer* Find(unsigned id);
+    // mark all lights layer can affect as dirty
+    void Invalidate(const Afx_layer& layer);
+    void Sort();
+    // store light color into layer, marking it dirty if changed
+    void Store(const Afx_layer& layer, Afx_layerDev& ld, Afx_compDev& cd,
+               uint8_t lid, Afx_colorcode c);
+
+   public:
+    // map - devices, for group masks and colors
+    Afx_compositor(Mappings* map) : map(map) {}
+
+    // Add empty layer, returns layer ID
+    unsigned AddLayer(int priority, int blend = AFX_BLEND_NORMAL);
+    void RemoveLayer(unsigned id);
+    bool SetPriority(unsigned id, int priority);
+    bool SetBlend(unsigned id, int blend);
+
+    // Restrict layer to lights (device PID, light ID, as in groups), empty
+    // list removes mask
+    bool SetMask(unsigned id, const std::vector<Afx_groupLight>& lights);
+
+    // Set layer light color, br is opacity (0 - transparent)
+    bool SetLight(unsigned id, uint32_t devID, uint8_t lid, Afx_colorcode c);
+
+    // Set color for all group lights
+    bool SetGroup(unsigned id, unsigned gid, Afx_colorcode c);
+
+    // Make all layer lights transparent
+    bool ClearLayer(unsigned id);
+
+    // Render layer content for device with effect every frame (nullptr -
+    // stop). Source time of its frames goes to composed frame.
+    bool SetSource(unsigned id, uint32_t devID,
+                   std::shared_ptr<Afx_effect> source);
+
+    Afx_compositorStats GetStats();
+
+    // Afx_effect, add to Engine for every device layers are shown on
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
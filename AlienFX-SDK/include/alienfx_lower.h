@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+struct Afx_caps {    // Hardware effect capabilities of device API
+    uint8_t types;   // per-light action types, bit mask of 1 << Action
+    uint8_t phases;  // maximal action phases per light
+    bool global;     // device-wide effects (SetGlobalEffects)
+};
+
+// Get capabilities for API version
+const Afx_caps& GetCaps(int version);
+
+// Check if device with API version can run light actions by itself
+bool HasHardwareActions(int version, const Afx_actions& act);
+
+struct Afx_effectDesc {  // High-level light effect
+    uint8_t type = AlienFX_A_Color;     // one of Action values
+    std::vector<Afx_colorcode> colors;  // phase colors
+    uint8_t time = 0, tempo = 0x64;     // phase time and tempo, as in actions
+    std::vector<uint8_t> lights;        // light IDs, empty for all lights
+    // device-wide effect code and mode for SetGlobalEffects, used if effect
+    // covers all device lights (0 - no global effect for it)
+    uint8_t globalType = 0, globalMode = 1;
+};
+
+// Ways to run effect, cheapest first
+#define AFX_LOWER_NONE 0      // nothing to set
+#define AFX_LOWER_GLOBAL 1    // device-wide hardware effect
+#define AFX_LOWER_HARDWARE 2  // per-light hardware actions
+#define AFX_LOWER_SOFTWARE 3  // engine-rendered frames
+
+struct Afx_lowered {  // Effect lowered for one device
+    int method = AFX_LOWER_NONE;
+    Afx_effectDesc desc;                 // source effect
+    std::vector<Afx_lightblock> blocks;  // light actions
+    std::shared_ptr<Afx_effect> effect;  // software effect
+    unsigned setupPackets = 0;           // USB reports to start effect
+    double packetsPerSec = 0,  // USB reports per second while running
+        softPacketsPerSec = 0;  // the same for software rendering
+    unsigned sentPackets = 0;   // reports actually sent by Apply
+    unsigned effectID = 0;      // engine effect ID for software method
+};
+
+// Lowers high-level effects to the cheapest form device supports: global
+// effect, per-light hardware actions, or software frames at engine rate.
+// Packet counts come from dry runs of device encoder, so device must be
+// present and not used by other threads meanwhile.
+class EffectCompiler {
+   private:
+    Engine* engine;
+    unsigned fps;
+
+   public:
+    // engine - engine for software effects (can be null if not needed)
+    // fps - frame rate used for software packets estimation
+    EffectCompiler(Engine* engine = nullptr, unsigned fps = 30)
+        : engine(engine), fps(fps) {}
+
+    // Lower effect for device. Returns method AFX_LOWER_NONE if device is
+    // not present or effect has no lights.
+    Afx_lowered Compile(Afx_device* dev, const Afx_effectDesc& desc);
+
+    // Start lowered effect at device. Software effects need engine.
+    bool Apply(Afx_device* dev, Afx_lowered& plan);
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AlienFX_SDK.h"
+
+namespace AlienFX_SDK {
+
+// Scene cache file layout (little endian):
+//   Afx_sceneHeader
+//   count x (flags byte, report of header length)
+#define AFX_SCENE_MAGIC 0x53584641  // "AFXS"
+#define AFX_SCENE_VERSION 1
+
+struct Afx_sceneHeader {
+    uint32_t magic = AFX_SCENE_MAGIC;
+    uint16_t version = AFX_SCENE_VERSION;
+    uint16_t length = 0;  // device report length
+    uint32_t devID = 0;   // packed VID/PID
+    int32_t api = 0;      // device API version
+    uint64_t key = 0;     // scene and device settings fingerprint
+    uint32_t count = 0;   // reports
+    uint32_t unused = 0;
+};
+
+struct Afx_sceneStats {  // Scene cache statistics
+    unsigned hits = 0;      // applied from memory
+    unsigned loaded = 0;    // loaded from disk
+    unsigned compiled = 0;  // encoded (new, changed or invalidated scene)
+};
+
+// Compiled scenes: report sequence produced by SetMultiAction and
+// UpdateColors for a set of light blocks, captured once per device and
+// replayed to transport without encoding. Colors get device white balance
+// and brightness, as engine frames do. Scenes are keyed by name and device,
+// and compiled again if light blocks, device type (VID/PID, API version,
+// report size) or device mappings (lights, white balance, brightness) are
+// changed. With storage directory set, compiled scenes are saved there and
+// survive restart.
+class Afx_sceneCache {
+   private:
+    struct Afx_scene {
+        uint64_t key = 0;
+        std::vector<Afx_report> reports;
+    };
+    std::string dir;  // storage directory, empty - memory only
+    std::mutex lock;
+    std::map<std::pair<std::string, uint32_t>, Afx_scene> scenes;
+    Afx_sceneStats stats;
+
+    // Fingerprint of blocks and device settings they are encoded with
+    static uint64_t Key(const Afx_device* dev,
+                        const std::vector<Afx_lightblock>& blocks);
+    std::string Path(const std::string& name, const Afx_device* dev) const;
+    bool Load(const std::string& name, const Afx_device* dev, uint64_t key,
+              Afx_scene& sc);
+    bool Store(const std::string& name, const Afx_device* dev,
+               const Afx_scene& sc);
+    // Find body, lock must be held
+    const std::vector<Afx_report>* Get(
+        const std::string& name, Afx_device* dev,
+        const std::vector<Afx_lightblock>& blocks);
+
+   public:
+    // dir - directory for compiled scenes, nullptr - keep in memory only
+    Afx_sceneCache(const char* dir = nullptr);
+
+    // Get reports for scene, compiling it if not cached or outdated.
+    // Name is part of file name, it can't start with '.' or contain '/'.
+    // Returns nullptr if device is not initialized or name is invalid.
+    // Pointer is valid until the scene is compiled again or removed.
+    const std::vector<Afx_report>* Find(
+        const std::string& name, Afx_device* dev,
+        const std::vector<Afx_lightblock>& blocks);
+
+    // Send scene to device. Call from the thread owning the device, or
+    // inside Engine::Run if engine is active for it.
+    bool Apply(const std::string& name, Afx_device* dev,
+               const std::vector<Afx_lightblock>& blocks);
+
+    // Drop scene from memory and storage for all devices
+    void Remove(const std::string& name);
+
+    // Drop all scenes from memory, stored ones are kept
+    void Clear();
+
+    Afx_sceneStats GetStats();
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Shared memory frame ring: client writes device frames straight into a
+// sealed memfd, daemon renders the latest complete one through Engine.
+// Slots are guarded by sequence counters (odd while written), so the
+// reader never blocks the writer and retries if a slot is reused under it.
+// Writer signals eventfd only if reader sleeps, so steady streaming costs
+// no syscalls besides those wakeups.
+#define AFX_SHM_MAGIC 0x4d484641  // "AFHM"
+#define AFX_SHM_VERSION 2
+#define AFX_SHM_SLOTS 4
+
+struct Afx_shmFrame {              // Ring slot
+    std::atomic<uint32_t> seq;     // odd while slot is written
+    uint32_t unused;
+    uint64_t time;                 // input time, Engine::Now() us, 0 - none
+    // light colors, indexed by light ID, br 0 - light not set (Afx_frame)
+    Afx_colorcode lights[AFX_FRAME_LIGHTS];
+};
+
+struct Afx_shmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;                 // AFX_SHM_SLOTS
+    std::atomic<uint32_t> taken;    // frames fetched by reader
+    std::atomic<uint32_t> head;     // frames committed, latest slot is
+                                    // (head - 1) % slots
+    std::atomic<uint32_t> armed;    // reader waits for eventfd signal
+    std::atomic<uint32_t> tail;     // head of last frame fetched by reader
+    uint32_t unused;
+    Afx_shmFrame frame[AFX_SHM_SLOTS];
+};
+
+class Afx_shmWriter {  // Client side of ring
+   private:
+    Afx_shmHeader* hdr = nullptr;
+    int memFd = -1, eventFd = -1;
+
+   public:
+    ~Afx_shmWriter() { Close(); }
+
+    // Create sealed ring and its eventfd
+    bool Create();
+    void Close();
+
+    // Descriptors to pass to daemon (alienfxd "attach" request)
+    int MemFd() const { return memFd; }
+    int EventFd() const { return eventFd; }
+
+    // Start frame, returns lights of the next slot to fill in place. Slot
+    // holds the frame written AFX_SHM_SLOTS frames ago, set every light
+    // needed (br 255) or clear it.
+    Afx_colorcode* Begin();
+
+    // Publish frame started by Begin and wake reader if it waits
+    // time - input time frame is based on (Engine::Now()), 0 - none
+    void Commit(uint64_t time = 0);
+
+    // Frames committed
+    uint32_t Frames() const { return hdr ? hdr->head.load() : 0; }
+
+    // Frames fetched by reader, the rest were coalesced
+    uint32_t Taken() const { return hdr ? hdr->taken.load() : 0; }
+
+    // Latest committed frame is not fetched by reader yet
+    bool Pending() const { return hdr && hdr->tail.load() != hdr->head.load(); }
+};
+
+struct Afx_shmStats {      // Reader statistics
+    unsigned frames = 0;   // frames rendered
+    unsigned skipped = 0;  // committed frames never rendered (coalesced)
+    unsigned retries = 0;  // slot reads repeated because of writer
+    unsigned wakeups = 0;  // eventfd signals received
+};
+
+class Afx_shmReader : public Afx_effect {  // Daemon side of ring
+   private:
+    Afx_shmHeader* hdr = nullptr;
+    int memFd = -1, eventFd = -1;
+    uint32_t rendered = 0;  // head of last rendered frame
+    Afx_colorcode last[AFX_FRAME_LIGHTS]{};
+    uint64_t lastTime = 0;
+    std::mutex lock;  // Render vs. Wake/GetStats
+    Afx_shmStats stats;
+
+    // Copy latest complete frame into last, false if none or unchanged
+    bool Fetch();
+
+   public:
+    ~Afx_shmReader();
+
+    // Take ownership of descriptors from client and map ring. Fails if ring
+    // is not sealed against resize or has wrong layout.
+    bool Attach(int memFd, int eventFd);
+
+    // eventfd to poll, readable when new frames are committed
+    int EventFd() const { return eventFd; }
+
+    // Drain eventfd and arm it again. Returns true if there are frames not
+    // rendered yet, so caller should Engine::Tick() without waiting.
+    bool Wake();
+
+    Afx_shmStats GetStats();
+
+    // Afx_effect, renders latest complete frame (last one if writer is busy)
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Software rendering of hardware light actions. Every light block runs its
+// phases in order, each phase stays for its time, then changes to the next
+// one according to its type with its tempo:
+// phase length, ms = time * 50 + transition
+// transition, ms = 64 + (255 - tempo) * 8
+class Afx_actionEffect : public Afx_effect {
+   private:
+    std::vector<Afx_lightblock> blocks;
+    std::vector<uint64_t> starts;
+
+   public:
+    // blocks - light actions to render, like for Functions::SetMultiAction
+    // starts - start time of every block (Engine::Now), empty if all blocks
+    // start with effect
+    Afx_actionEffect(const std::vector<Afx_lightblock>& blocks,
+                     const std::vector<uint64_t>& starts = {})
+        : blocks(blocks), starts(starts) {}
+
+    // Color of light block at time t (us)
+    static Afx_colorcode Eval(const Afx_lightblock& block, uint64_t t);
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+// Emulation of light actions device API can't run. Actions device supports
+// are sent to it as usual, others are rendered by engine, so the same
+// actions look the same at every device. Engine should be started.
+class Afx_emulator {
+   private:
+    Engine* engine;
+    struct Afx_emulated {  // emulated lights of device
+        std::map<uint8_t, std::pair<Afx_lightblock, uint64_t>> lights;
+        unsigned effectID = 0;
+    };
+    std::map<uint32_t, Afx_emulated> devs;
+    std::mutex lock;
+
+   public:
+    Afx_emulator(Engine* engine) : engine(engine) {}
+    ~Afx_emulator() { Clear(); }
+
+    // Set light actions, the same way as Functions::SetMultiAction. Lights
+    // not in act keep their current actions.
+    bool SetMultiAction(Afx_device* dev,
+                        const std::vector<Afx_lightblock>& act);
+
+    // Stop emulation for all devices
+    void Clear();
+};
+
+}  // namespace AlienFX_SDK
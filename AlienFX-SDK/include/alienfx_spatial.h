@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Spatial effect types:
+#define AFX_SPATIAL_LINEAR 0  // linear gradient along direction
+#define AFX_SPATIAL_RADIAL 1  // radial gradient from origin
+#define AFX_SPATIAL_WAVE 2    // wave moving along direction
+#define AFX_SPATIAL_RIPPLE 3  // rings moving out from origin
+#define AFX_SPATIAL_BITMAP 4  // bitmap scrolling along direction
+
+struct Afx_spatial {  // Spatial effect parameters, in grid cells
+    int type = AFX_SPATIAL_LINEAR;
+    Afx_colorcode from{}, to{};  // colors for effect minimum and maximum
+    float x = 0, y = 0;          // origin cell
+    float angle = 0;             // direction, degrees (0 - to the right)
+    float length = 0;  // gradient or wave length, ring spacing (0 - grid size)
+    float speed = 0;   // wave: lengths per second, ripple and bitmap: cells
+                       // per second. Gradients are static.
+    float width = 2;     // ripple ring width
+    unsigned rings = 1;  // ripple rings, 0 - endless
+    unsigned bw = 0, bh = 0;            // bitmap size
+    std::vector<Afx_colorcode> bitmap;  // bitmap, row by row
+};
+
+// Renders spatial effect over one of mappings grids. Grid cells are stored
+// row by row and hold light device PID and ID, so one effect object can be
+// added to engine for every device at the grid. Grid is evaluated once per
+// engine frame, then each device picks up its own lights.
+class Afx_gridEffect : public Afx_effect {
+   private:
+    Mappings* map;
+    uint8_t gridID;
+    Afx_spatial params;
+
+    // grid layout cache, non-empty cells only
+    unsigned gen = ~0u,  // mappings layoutGen cache was built for
+        gx = 0, gy = 0;
+    std::vector<Afx_groupLight> cells;
+    std::vector<float> cx, cy,  // cell coordinates
+        u;                      // projection or distance from origin
+    float span = 0,             // maximal u over grid
+        len = 1;                // effective length
+    // frame evaluation
+    uint64_t evalStamp = 0;
+    bool finished = false;
+    std::vector<float> f;            // effect value for cells, 0..1
+    std::vector<Afx_colorcode> out;  // cell colors
+
+    // Rebuild cell cache if grid changed, false if grid is not found
+    bool UpdateLayout();
+    // Evaluate cell colors for time t (us)
+    void Evaluate(uint64_t t);
+
+   public:
+    // map - mappings with grid, gridID - grid ID, params - effect parameters
+    Afx_gridEffect(Mappings* map, uint8_t gridID, const Afx_spatial& params)
+        : map(map), gridID(gridID), params(params) {}
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "alienfx_engine.h"
+
+namespace AlienFX_SDK {
+
+// Keyframe easing to the next keyframe:
+#define AFX_EASE_LINEAR 0
+#define AFX_EASE_STEP 1      // hold color until next keyframe
+#define AFX_EASE_IN 2        // slow start
+#define AFX_EASE_OUT 3       // slow end
+#define AFX_EASE_IN_OUT 4    // slow start and end
+#define AFX_EASE_COUNT 5
+
+// Timeline track targets:
+#define AFX_TRACK_LIGHT 0  // one light, target is Afx_groupLight word
+#define AFX_TRACK_GROUP 1  // all lights of group, target is group ID
+
+// Timeline file layout (little endian):
+//   Afx_timelineHeader
+//   Afx_trackEntry[tracks]
+//   Afx_keyframe arrays, sorted by time, at track entry offsets
+#define AFX_TIMELINE_MAGIC 0x54584641  // "AFXT"
+#define AFX_TIMELINE_VERSION 1
+
+struct Afx_keyframe {  // Timeline keyframe, 8 bytes
+    uint32_t time;     // ms from timeline start
+    uint8_t r, g, b;
+    uint8_t easing;    // easing to the next keyframe
+};
+
+struct Afx_timelineHeader {
+    uint32_t magic = AFX_TIMELINE_MAGIC;
+    uint16_t version = AFX_TIMELINE_VERSION;
+    uint16_t flags = 0;
+    uint32_t tracks = 0;
+    uint32_t duration = 0;  // ms
+};
+
+struct Afx_trackEntry {
+    uint8_t kind;  // AFX_TRACK_*
+    uint8_t reserved[3];
+    uint32_t target;
+    uint32_t keys;    // keyframe count
+    uint32_t unused;
+    uint64_t offset;  // keyframes offset in file
+};
+
+struct Afx_track {  // Editable timeline track
+    uint8_t kind = AFX_TRACK_LIGHT;
+    uint32_t target = 0;
+    std::vector<Afx_keyframe> keys;
+};
+
+// Editable timeline, for building and saving shows
+class Afx_timeline {
+   public:
+    std::vector<Afx_track> tracks;
+    uint32_t duration = 0;  // ms, 0 - last keyframe time
+
+    // Add keyframe to track for light or group, creating track if needed
+    void AddKey(uint8_t kind, uint32_t target, uint32_t time,
+                Afx_colorcode color, uint8_t easing = AFX_EASE_LINEAR);
+
+    // Save timeline file, keyframes are sorted by time
+    bool Save(const char* path);
+};
+
+// Plays timeline file through engine. File is memory-mapped, so keyframes
+// are paged in while playing and long shows don't need to fit in memory.
+// Every track keeps a cursor, which moves forward at playback and is found
+// by binary search after seek. Add one object to engine for every device
+// used by the show.
+class Afx_timelinePlayer : public Afx_effect {
+   private:
+    Mappings* map;
+    uint8_t* data = nullptr;  // mapped file
+    size_t size = 0;
+    const Afx_timelineHeader* header = nullptr;
+    const Afx_trackEntry* entries = nullptr;
+    std::vector<uint32_t> cursors;  // current keyframe for every track
+    std::mutex lock;                // seek request lock
+    int64_t seekPos = -1;           // ms, -1 - no request
+    int64_t anchor = 0;             // effect time of position 0, us
+
+    const Afx_keyframe* Keys(unsigned track) const {
+        return (const Afx_keyframe*)(data + entries[track].offset);
+    }
+    // Color of track at position, false if before first keyframe
+    bool Eval(unsigned track, uint32_t pos, Afx_colorcode& color);
+
+   public:
+    bool loop = false;  // restart at the end of timeline
+
+    Afx_timelinePlayer(Mappings* map) : map(map) {}
+    ~Afx_timelinePlayer();
+
+    // Map timeline file and check its layout. Call before player is added
+    // to engine, playback starts from 0.
+    bool Open(const char* path);
+    void Close();
+
+    // Timeline length, ms
+    uint32_t Duration() const { return header ? header->duration : 0; }
+
+    // Continue playback from position (ms) at next frame
+    void Seek(uint32_t pos);
+
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override;
+};
+
+}  // namespace AlienFX_SDK
@@ -3,8 +3,12 @@
 #include <hidapi.h>
 #include <hidapi_libusb.h>
 #include <libusb.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
@@ -20,6 +24,27 @@
 namespace AlienFX_SDK {
 using json = nlohmann::json;
 
+Afx_nameID Afx_names::Intern(std::string_view name) {
+    auto pos = index.find(name);
+    if (pos != index.end()) return pos->second;
+    Afx_nameID id = (Afx_nameID)strings.size();
+    index.emplace(strings.emplace_back(name), id);
+    return id;
+}
+
+void Afx_names::Clear() {
+    index.clear();
+    strings.clear();
+    index.emplace(strings.emplace_back(), 0);
+}
+
+// Serialized mappings sections, updated only for changed parts
+struct Afx_mapCache {
+    json devices = json::array(), groups = json::array(),
+         grids = json::array();
+};
+
+
 vector<Afx_icommand>* Functions::SetMaskAndColor(vector<Afx_icommand>* mods,
                                                  Afx_lightblock* act,
                                                  bool needInverse,
@@ -110,12 +135,26 @@ bool Functions::PrepareAndSend(const uint8_t* command,
     LOG_S(INFO) << oss.str();
 
 #endif
-    if (!devHandle) {
+    bool feature = version == API_V8 && needV8Feature;
+    if (capture) {
+        capture->push_back(
+            {{buffer, buffer + length},
+             (uint8_t)((feature ? AFX_REPORT_FEATURE : 0) |
+                       (captureWait ? AFX_REPORT_WAIT : 0))});
+        captureWait = false;
+        return true;
+    }
+    return SendReport(buffer, feature);
+}
+
+bool Functions::SendReport(uint8_t* buffer, bool feature) {
+    if (!devHandle && !simulated) {
         LOG_S(ERROR) << "HID device not open";
         return false;
     }
-    bool result = false;
-    switch (version) {
+    reports++;
+    bool result = simulated;  // simulated device sends nothing
+    switch (simulated ? API_UNKNOWN : version) {
         case API_V2:
         case API_V3:
         case API_V4:
@@ -132,7 +171,7 @@ bool Functions::PrepareAndSend(const uint8_t* command,
             result = ReadFile(devHandle, buffer, length);
             break;
         case API_V8:
-            if (needV8Feature) {
+            if (feature) {
                 usleep(3000);
                 result = HidD_SetFeature(devHandle, buffer, length);
                 usleep(6000);
@@ -143,6 +182,12 @@ bool Functions::PrepareAndSend(const uint8_t* command,
 
             break;
     }
+    if (reportStamp) {
+        *reportStamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+        reportStamp = nullptr;
+    }
     return result;
 }
 
@@ -231,7 +276,7 @@ bool Functions::AlienFXProbeDevice(libusb_context* ctxx, unsigned short vidd,
     }
     vid = vidd;
     pid = pidd;
-    path = pathh;
+    path = pathh ? pathh : "";
     // NOTE: Open path should not hang kbd while testing it? else fallback
     if (pathh)
         devHandle = hid_open_path(pathh);
@@ -270,6 +315,39 @@ bool Functions::AlienFXProbeDevice(libusb_context* ctxx, unsigned short vidd,
     return version != API_UNKNOWN;
 }
 
+bool Functions::AlienFXSimulate(unsigned short vidd, unsigned short pidd,
+                                int ver) {
+    // report lengths as probed from real devices of each API
+    switch (ver) {
+        case API_V2:
+            length = 8;
+            break;
+        case API_V3:
+            length = 11;
+            break;
+        case API_V4:
+            length = 34;
+            break;
+        case API_V5:
+        case API_V8:
+            length = 64;
+            break;
+        case API_V6:
+        case API_V7:
+            length = 65;
+            break;
+        default:
+            return false;
+    }
+    version = ver;
+    vid = vidd;
+    pid = pidd;
+    path.clear();
+    description = "Simulated device";
+    simulated = true;
+    return true;
+}
+
 // NOTE: Not needed? as we already initalize in probe
 //
 //   bool Functions::AlienFXInitialize(unsigned short vidd, unsigned short
@@ -872,6 +950,19 @@ bool Functions::SetGlobalEffects(std::uint8_t effType, std::uint8_t mode,
 std::uint8_t Functions::GetDeviceStatus() {
     std::uint8_t buffer[MAX_BUFFERSIZE];
     // unsigned long written;
+    // dry run, report idle device, replay will wait here
+    if (capture || simulated) {
+        if (capture) captureWait = true;
+        switch (version) {
+            case API_V5:
+                return 0;
+            case API_V4:
+                return ALIENFX_V4_READY;
+            case API_V3:
+            case API_V2:
+                return ALIENFX_V2_READY;
+        }
+    }
     if (devHandle) switch (version) {
             // case API_V9:
             //	HidD_GetInputReport(devHandle, buffer, length);
@@ -1000,9 +1091,20 @@ Mappings::Mappings() {
 }
 
 Mappings::~Mappings() {
+    StopWatch();
+    if (saveThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(saveLock);
+            saveStop = true;
+        }
+        saveCond.notify_one();
+        saveThread.join();
+    }
+    Flush();
     for (auto& d : fxdevs) {
         delete d.dev;
     }
+    for (auto dev : released) delete dev;
     if (ctx) {
         libusb_exit(ctx);
 #ifdef DEBUG
@@ -1014,10 +1116,21 @@ Mappings::~Mappings() {
 void Mappings::AlienFxUpdateDevice(Functions* dev) {
     auto devInfo = GetDeviceById(dev->pid, dev->vid);
     if (devInfo) {
-        devInfo->version = dev->version;
+        // keep cached path and capabilities up to date
+        if (devInfo->version != dev->version ||
+            (!dev->path.empty() && devInfo->path != dev->path)) {
+            if (!dev->path.empty()) devInfo->path = dev->path;
+            devInfo->version = dev->version;
+            MarkDirty(ALIENFX_MAP_DEVICES);
+        }
         devInfo->present = true;
         activeLights += (unsigned)devInfo->lights.size();
-        if (devInfo->dev) {
+        if (devInfo->dev && devInfo->dev->path != dev->path) {
+            // replugged between scans, old handle is dead
+            released.push_back(devInfo->dev);
+            devInfo->dev = dev;
+            deviceListChanged = devInfo->arrived = true;
+        } else if (devInfo->dev) {
             delete dev;
 #ifdef DEBUG
             LOG_S(INFO) << "Scan: VID: " << std::hex << devInfo->vid
@@ -1038,9 +1151,11 @@ void Mappings::AlienFxUpdateDevice(Functions* dev) {
         activeDevices++;
     } else {
         fxdevs.push_back(
-            {dev->pid, dev->vid, dev, dev->description, dev->version});
+            {dev->pid, dev->vid, dev, names.Intern(dev->description),
+             dev->version});
         deviceListChanged = fxdevs.back().arrived = fxdevs.back().present =
             true;
+        fxdevs.back().path = dev->path;
         activeDevices++;
 #ifdef DEBUG
         LOG_S(INFO) << "Scan: VID: " << std::hex << dev->vid
@@ -1050,9 +1165,13 @@ void Mappings::AlienFxUpdateDevice(Functions* dev) {
     }
 }
 bool Mappings::AlienFXEnumDevices(void* acc) {
+    std::lock_guard<std::recursive_mutex> lock(mapLock);
     Functions* dev = nullptr;
     deviceListChanged = false;
 
+    // Devices and lights added by external edit, pointers can move here
+    ApplyMerged();
+
     // Reset active status
     for (auto& d : fxdevs) d.present = false;
     activeDevices = activeLights = 0;
@@ -1087,14 +1206,35 @@ bool Mappings::AlienFXEnumDevices(void* acc) {
             deviceListChanged = true;
             LOG_S(INFO) << "Device removed - VID: 0x" << std::hex << d.vid
                         << ", PID: 0x" << d.pid;
+            released.push_back(d.dev);
+            d.dev = nullptr;
             d.arrived = false;
-            break;
         }
     }
 
     return deviceListChanged;
 }
 
+bool Mappings::MergePending() {
+    std::lock_guard<std::recursive_mutex> lock(mapLock);
+    return !fileDevs.empty();
+}
+
+bool Mappings::ApplyMerged() {
+    std::lock_guard<std::recursive_mutex> lock(mapLock);
+    if (fileDevs.empty()) return false;
+    for (auto& d : fileDevs) {
+        Afx_device* cur = GetDeviceById(d.devID);
+        if (cur)
+            cur->lights = std::move(d.lights);
+        else
+            fxdevs.push_back(std::move(d));
+    }
+    fileDevs.clear();
+    layoutGen++;
+    return true;
+}
+
 Afx_device* Mappings::GetDeviceById(unsigned short pid, unsigned short vid) {
     for (auto pos = fxdevs.begin(); pos < fxdevs.end(); pos++)
         if (pos->pid == pid && (!vid || pos->vid == vid)) {
@@ -1103,7 +1243,7 @@ Afx_device* Mappings::GetDeviceById(unsigned short pid, unsigned short vid) {
     return nullptr;
 }
 
-Afx_device* Mappings::GetDeviceById(unsigned long devID) {
+Afx_device* Mappings::GetDeviceById(uint32_t devID) {
     for (auto pos = fxdevs.begin(); pos < fxdevs.end(); pos++)
         if (pos->devID == devID) {
             return &(*pos);
@@ -1117,7 +1257,7 @@ Afx_grid* Mappings::GetGridByID(uint8_t id) {
     return nullptr;
 }
 
-Afx_device* Mappings::AddDeviceById(unsigned long devID) {
+Afx_device* Mappings::AddDeviceById(uint32_t devID) {
     Afx_device* dev = GetDeviceById(devID);
     if (!dev) {
         fxdevs.push_back({LOWORD(devID), HIWORD(devID), NULL});
@@ -1156,7 +1296,7 @@ void Mappings::RemoveMapping(Afx_device* dev, unsigned short lightID) {
     }
 }
 
-Afx_group* Mappings::GetGroupById(unsigned long gID) {
+Afx_group* Mappings::GetGroupById(uint32_t gID) {
     for (auto pos = groups.begin(); pos != groups.end(); pos++)
         if (pos->gid == gID) return &(*pos);
     return nullptr;
@@ -1191,181 +1331,335 @@ void Mappings::EnsureParentDirExists(const std::filesystem::path& p) {
     std::filesystem::create_directories(p.parent_path(), ec);
 }
 
-void Mappings::LoadMappings(const char* username) {
-    const auto path = GetMappingsPath(username);
+// Mappings file layout version written by SaveMappings()
+static constexpr int mappingsSchema = 2;
+
+// v1 -> v2: all fields made explicit, device path and capability cache
+// added, grid cells packed into did/lid words.
+static void MigrateMappingsV1(json& j) {
+    json devs = json::array();
+    if (j.contains("devices") && j["devices"].is_array())
+        for (const auto& jd : j["devices"]) {
+            json lights = json::array();
+            if (jd.contains("lights") && jd["lights"].is_array())
+                for (const auto& jl : jd["lights"])
+                    lights.push_back({{"lightid", jl.value("lightid", 0)},
+                                      {"flags", jl.value("flags", 0)},
+                                      {"scancode", jl.value("scancode", 0)},
+                                      {"name", jl.value("name", "")}});
+            devs.push_back({{"vid", jd.value("vid", 0)},
+                            {"pid", jd.value("pid", 0)},
+                            {"name", jd.value("name", "")},
+                            {"white", jd.value("white", 0)},
+                            {"brightness", jd.value("brightness", 0)},
+                            {"path", ""},
+                            {"caps", {{"version", API_UNKNOWN}}},
+                            {"lights", std::move(lights)}});
+        }
+    j["devices"] = std::move(devs);
+
+    json grps = json::array();
+    if (j.contains("groups") && j["groups"].is_array())
+        for (const auto& jg : j["groups"]) {
+            json lights = json::array();
+            if (jg.contains("lights") && jg["lights"].is_array())
+                for (const auto& jgl : jg["lights"])
+                    lights.push_back(
+                        {{"did", jgl.value("did", 0)}, {"lid", jgl.value("lid", 0)}});
+            grps.push_back({{"gid", jg.value("gid", 0)},
+                            {"name", jg.value("name", "")},
+                            {"lights", std::move(lights)}});
+        }
+    j["groups"] = std::move(grps);
+
+    json grds = json::array();
+    if (j.contains("grids") && j["grids"].is_array())
+        for (const auto& jgr : j["grids"]) {
+            const size_t n =
+                (size_t)jgr.value("x", 0) * (size_t)jgr.value("y", 0);
+            json cells = json::array();
+            if (jgr.contains("grid") && jgr["grid"].is_array())
+                for (const auto& cell : jgr["grid"]) {
+                    if (cells.size() >= n) break;
+                    cells.push_back(
+                        ((uint32_t)cell.value("lid", 0) << 16) |
+                        (unsigned short)cell.value("did", 0));
+                }
+            while (cells.size() < n) cells.push_back(0);
+            grds.push_back({{"id", jgr.value("id", 0)},
+                            {"x", jgr.value("x", 0)},
+                            {"y", jgr.value("y", 0)},
+                            {"name", jgr.value("name", "")},
+                            {"cells", std::move(cells)}});
+        }
+    j["grids"] = std::move(grds);
+}
+
+// Migration steps, index is the version they upgrade from
+static void (*const mappingsMigrations[mappingsSchema])(json&) = {
+    nullptr,           // v0 - never written
+    MigrateMappingsV1  // v1 -> v2
+};
+
+// Parsed mappings file content
+struct Afx_mapData {
+    Afx_names names;  // names used by this data
+    std::vector<Afx_device> devs;
+    std::vector<Afx_group> grps;
+    std::vector<Afx_grid> grds;
+    bool migrated = false;  // file had older schema
+    bool newer = false;     // file has newer schema, must not be rewritten
+};
+
+// Read and parse mappings file, upgrading it to the current layout
+static bool ReadMappings(const std::filesystem::path& path, Afx_mapData& m) {
     if (!std::filesystem::exists(path)) {
 #ifdef DEBUG
         LOG_S(INFO) << "No mappings file found at: " << path.string();
 #endif
-        return;  // nothing to load
+        return false;  // nothing to load
     }
     std::ifstream in(path);
     if (!in.is_open()) {
         LOG_S(ERROR) << "Failed to open mappings file for reading: "
                      << path.string();
-        return;
+        return false;
     }
     json j;
     try {
         in >> j;
     } catch (const std::exception& e) {
         LOG_S(ERROR) << "Failed to parse mappings json: " << e.what();
-        return;
+        return false;
     }
-    // Clear existing data
-    fxdevs.clear();
-    groups.clear();
-    grids.clear();
-
-    const int schemaVersion = j.value("schemaVersion", 1);
-    (void)schemaVersion;  // reserved for future migrations
 
-    // Devices
-    if (j.contains("devices") && j["devices"].is_array()) {
-        for (const auto& jd : j["devices"]) {
+    // Bring older layouts to the current one
+    int schemaVersion = j.value("schemaVersion", 1);
+    if (schemaVersion < 1) {
+        LOG_S(ERROR) << "Invalid mappings file schema v" << schemaVersion;
+        return false;
+    }
+    m.migrated = schemaVersion < mappingsSchema;
+    m.newer = schemaVersion > mappingsSchema;
+    if (m.newer)
+        LOG_S(WARNING) << "Mappings file schema v" << schemaVersion
+                       << " is newer than supported v" << mappingsSchema
+                       << ", changes will not be saved";
+    for (; schemaVersion < mappingsSchema; schemaVersion++)
+        mappingsMigrations[schemaVersion](j);
+
+    auto& devs = m.devs;
+    auto& grps = m.grps;
+    auto& grds = m.grds;
+    try {
+        // Devices
+        for (const auto& jd : j.at("devices")) {
             Afx_device d{};
-            d.vid = (unsigned short)jd.value("vid", 0);
-            d.pid = (unsigned short)jd.value("pid", 0);
-            d.devID = ((unsigned long)d.vid << 16) |
+            jd.at("vid").get_to(d.vid);
+            jd.at("pid").get_to(d.pid);
+            d.devID = ((uint32_t)d.vid << 16) |
                       d.pid;  // consistent with LOWORD/HIWORD usage
-            d.name = jd.value("name", std::string{});
-            d.white.ci = (unsigned long)jd.value("white", 0);
-            d.brightness = (std::uint8_t)jd.value("brightness", 0);
-
-            d.present = false;
-            d.arrived = false;
-            d.dev = nullptr;
-
-            if (jd.contains("lights") && jd["lights"].is_array()) {
-                for (const auto& jl : jd["lights"]) {
-                    Afx_light l{};
-                    l.lightid = (std::uint8_t)jl.value("lightid", 0);
-                    l.flags = (unsigned long)jl.value("flags", 0);
-                    l.scancode = (unsigned short)jl.value("scancode", 0);
-                    l.name = jl.value("name", std::string{});
-                    d.lights.push_back(std::move(l));
-                }
+            d.nameid = m.names.Intern(jd.at("name").get<std::string>());
+            jd.at("white").get_to(d.white.ci);
+            jd.at("brightness").get_to(d.brightness);
+            jd.at("path").get_to(d.path);
+            jd.at("caps").at("version").get_to(d.version);
+
+            for (const auto& jl : jd.at("lights")) {
+                Afx_light l{};
+                jl.at("lightid").get_to(l.lightid);
+                jl.at("flags").get_to(l.flags);
+                jl.at("scancode").get_to(l.scancode);
+                l.nameid = m.names.Intern(jl.at("name").get<std::string>());
+                d.lights.push_back(std::move(l));
             }
 
-            fxdevs.push_back(std::move(d));
+            devs.push_back(std::move(d));
         }
-    }
-    // Groups
-    if (j.contains("groups") && j["groups"].is_array()) {
-        for (const auto& jg : j["groups"]) {
+        // Groups
+        for (const auto& jg : j.at("groups")) {
             Afx_group g{};
-            g.gid = (unsigned long)jg.value("gid", 0);
-            g.name = jg.value("name", std::string{});
-
-            if (jg.contains("lights") && jg["lights"].is_array()) {
-                for (const auto& jgl : jg["lights"]) {
-                    Afx_groupLight gl{};
-                    gl.did = (unsigned long)jgl.value("did", 0);
-                    gl.lid = (std::uint8_t)jgl.value("lid", 0);
-                    g.lights.push_back(gl);
-                }
+            jg.at("gid").get_to(g.gid);
+            g.nameid = m.names.Intern(jg.at("name").get<std::string>());
+            for (const auto& jgl : jg.at("lights")) {
+                Afx_groupLight gl{};
+                jgl.at("did").get_to(gl.did);
+                jgl.at("lid").get_to(gl.lid);
+                g.lights.push_back(gl);
             }
-            groups.push_back(std::move(g));
+            grps.push_back(std::move(g));
         }
-    }
-    // Grids
-    if (j.contains("grids") && j["grids"].is_array()) {
-        for (const auto& jgr : j["grids"]) {
+        // Grids
+        for (const auto& jgr : j.at("grids")) {
             Afx_grid gr{};
-            gr.id = (std::uint8_t)jgr.value("id", 0);
-            gr.x = (std::uint8_t)jgr.value("x", 0);
-            gr.y = (std::uint8_t)jgr.value("y", 0);
-            gr.name = jgr.value("name", std::string{});
+            jgr.at("id").get_to(gr.id);
+            jgr.at("x").get_to(gr.x);
+            jgr.at("y").get_to(gr.y);
+            gr.nameid = m.names.Intern(jgr.at("name").get<std::string>());
 
+            const auto& cells = jgr.at("cells");
             const size_t n = (size_t)gr.x * (size_t)gr.y;
-            if (n > 0) {
-                gr.grid = new Afx_groupLight[n]{};
-                // default-initialized
-                if (jgr.contains("grid") && jgr["grid"].is_array()) {
-                    size_t idx = 0;
-                    for (const auto& cell : jgr["grid"]) {
-                        if (idx >= n) break;
-                        gr.grid[idx].did = (unsigned long)cell.value("did", 0);
-                        gr.grid[idx].lid = (std::uint8_t)cell.value("lid", 0);
-                        idx++;
-                    }
-                }
-            } else {
-                gr.grid = nullptr;
-            }
+            gr.grid = n ? new Afx_groupLight[n]{} : nullptr;
+            for (size_t idx = 0; idx < n && idx < cells.size(); idx++)
+                cells[idx].get_to(gr.grid[idx].lgh);
 
-            grids.push_back(std::move(gr));
+            grds.push_back(std::move(gr));
         }
+    } catch (const std::exception& e) {
+        LOG_S(ERROR) << "Invalid mappings file layout: " << e.what();
+        for (auto& gr : grds) delete[] gr.grid;
+        grds.clear();
+        return false;
+    }
+    return true;
+}
+
+void Mappings::LoadMappings(const char* username) {
+    const auto path = GetMappingsPath(username);
+    Afx_mapData m;
+    if (!ReadMappings(path, m)) return;
+
+
+    std::lock_guard<std::recursive_mutex> lock(mapLock);
+    {
+        std::lock_guard<std::mutex> slock(saveLock);
+        saveUser = username ? username : "";
+        dirty = 0;
+        keepFile = m.newer;
     }
+    cache.reset();
+    // Replace existing data
+    for (auto& gr : grids) delete[] gr.grid;
+    fileDevs.clear();
+    names = std::move(m.names);
+    fxdevs = std::move(m.devs);
+    groups = std::move(m.grps);
+    grids = std::move(m.grds);
+    layoutGen++;
+
+    // store upgraded layout back
+    if (m.migrated) MarkDirty(ALIENFX_MAP_ALL, username);
 
 #ifdef DEBUG
     LOG_S(INFO) << "Loaded mappings from: " << path.string();
 #endif
 }
 
-void Mappings::SaveMappings(const char* username) {
-    json j;
-    j["schemaVersion"] = 1;
-
-    // Devices
-    j["devices"] = json::array();
-    for (const auto& d : fxdevs) {
-        json jd;
-        jd["vid"] = d.vid;
-        jd["pid"] = d.pid;
-        jd["name"] = d.name;
-        jd["white"] = d.white.ci;
-        jd["brightness"] = d.brightness;
-
-        jd["lights"] = json::array();
-        for (const auto& l : d.lights) {
-            jd["lights"].push_back({
-                {"lightid", l.lightid},
-                {"flags", l.flags},
-                {"scancode", l.scancode},
-                {"name", l.name},
-            });
-        }
+static json DeviceHeaderToJson(const Afx_device& d, const Afx_names& names) {
+    return {{"vid", d.vid},
+            {"pid", d.pid},
+            {"name", names.Get(d.nameid)},
+            {"white", d.white.ci},
+            {"brightness", d.brightness},
+            {"path", d.path},
+            {"caps", {{"version", d.version}}}};
+}
 
-        j["devices"].push_back(std::move(jd));
+static json LightsToJson(const Afx_device& d, const Afx_names& names) {
+    json jl = json::array();
+    for (const auto& l : d.lights) {
+        jl.push_back({
+            {"lightid", l.lightid},
+            {"flags", l.flags},
+            {"scancode", l.scancode},
+            {"name", names.Get(l.nameid)},
+        });
     }
+    return jl;
+}
 
-    // Groups
-    j["groups"] = json::array();
-    for (const auto& g : groups) {
-        json jg;
-        jg["gid"] = g.gid;
-        jg["name"] = g.name;
-
-        jg["lights"] = json::array();
-        for (const auto& gl : g.lights) {
-            jg["lights"].push_back({{"did", gl.did}, {"lid", gl.lid}});
+bool Mappings::WriteMappings(int sections) {
+    // writer thread and Flush share cache and temp file
+    std::lock_guard<std::mutex> wlock(writeLock);
+    std::string user;
+    {
+        std::lock_guard<std::mutex> slock(saveLock);
+        user = saveUser;
+        if (keepFile) {
+            // don't drop fields this version doesn't know
+            LOG_S(WARNING) << "Mappings file has newer schema, not saved";
+            return true;
         }
-
-        j["groups"].push_back(std::move(jg));
     }
+    json j;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mapLock);
+        if (!cache) {
+            cache = std::make_unique<Afx_mapCache>();
+            sections = ALIENFX_MAP_ALL;
+        }
+        // Devices - rebuild all if list size changed, otherwise only
+        // changed parts of each device block
+        if (cache->devices.size() != fxdevs.size())
+            sections |= ALIENFX_MAP_DEVICES | ALIENFX_MAP_LIGHTS;
+        if (sections & (ALIENFX_MAP_DEVICES | ALIENFX_MAP_LIGHTS)) {
+            cache->devices.get_ref<json::array_t&>().resize(fxdevs.size());
+            for (size_t i = 0; i < fxdevs.size(); i++) {
+                json& jd = cache->devices[i];
+                if (sections & ALIENFX_MAP_DEVICES || !jd.is_object()) {
+                    json lights = jd.is_object() && jd.contains("lights")
+                                      ? std::move(jd["lights"])
+                                      : LightsToJson(fxdevs[i], names);
+                    jd = DeviceHeaderToJson(fxdevs[i], names);
+                    jd["lights"] = std::move(lights);
+                }
+                if (sections & ALIENFX_MAP_LIGHTS)
+                    jd["lights"] = LightsToJson(fxdevs[i], names);
+            }
+        }
 
-    // Grids
-    j["grids"] = json::array();
-    for (const auto& gr : grids) {
-        json jgr;
-        jgr["id"] = gr.id;
-        jgr["x"] = gr.x;
-        jgr["y"] = gr.y;
-        jgr["name"] = gr.name;
+        // Groups
+        if (sections & ALIENFX_MAP_GROUPS) {
+            cache->groups = json::array();
+            for (const auto& g : groups) {
+                json jg;
+                jg["gid"] = g.gid;
+                jg["name"] = names.Get(g.nameid);
+
+                jg["lights"] = json::array();
+                for (const auto& gl : g.lights) {
+                    jg["lights"].push_back({{"did", gl.did}, {"lid", gl.lid}});
+                }
 
-        jgr["grid"] = json::array();
-        const size_t n = (size_t)gr.x * (size_t)gr.y;
-        if (gr.grid && n > 0) {
-            for (size_t i = 0; i < n; i++) {
-                jgr["grid"].push_back(
-                    {{"did", gr.grid[i].did}, {"lid", gr.grid[i].lid}});
+                cache->groups.push_back(std::move(jg));
             }
         }
 
-        j["grids"].push_back(std::move(jgr));
+        // Grids
+        if (sections & ALIENFX_MAP_GRIDS) {
+            cache->grids = json::array();
+            for (const auto& gr : grids) {
+                json jgr;
+                jgr["id"] = gr.id;
+                jgr["x"] = gr.x;
+                jgr["y"] = gr.y;
+                jgr["name"] = names.Get(gr.nameid);
+
+                jgr["cells"] = json::array();
+                const size_t n = (size_t)gr.x * (size_t)gr.y;
+                if (gr.grid && n > 0) {
+                    for (size_t i = 0; i < n; i++)
+                        jgr["cells"].push_back(gr.grid[i].lgh);
+                }
+
+                cache->grids.push_back(std::move(jgr));
+            }
+        }
+
+        j["schemaVersion"] = mappingsSchema;
+        j["devices"] = cache->devices;
+        // merged devices waiting for scan
+        for (const auto& d : fileDevs)
+            if (!GetDeviceById(d.devID)) {
+                json jd = DeviceHeaderToJson(d, names);
+                jd["lights"] = LightsToJson(d, names);
+                j["devices"].push_back(std::move(jd));
+            }
+        j["groups"] = cache->groups;
+        j["grids"] = cache->grids;
     }
-    const auto path = GetMappingsPath(username);
+
+    const auto path = GetMappingsPath(user.c_str());
     EnsureParentDirExists(path);
 
     // Write atomically: write temp then rename
@@ -1374,12 +1668,15 @@ void Mappings::SaveMappings(const char* username) {
         std::ofstream out(tmp, std::ios::trunc);
         if (!out.is_open()) {
             LOG_S(ERROR) << "Failed to open mappings file for writing: " << tmp;
-            return;
+            return false;
         }
         out << j.dump(2) << "\n";
     }
 
     std::error_code ec;
+    // counted before rename, so watch thread can't see the event first
+    bool counted = watchFd >= 0;
+    if (counted) selfWrites++;
     std::filesystem::rename(tmp, path, ec);
     if (ec) {
         // fallback: try overwrite
@@ -1389,14 +1686,235 @@ void Mappings::SaveMappings(const char* username) {
     }
 
     if (ec) {
+        if (counted) selfWrites--;  // no rename, no event
         LOG_S(ERROR) << "Failed to move mappings temp file into place: "
                      << ec.message();
-        return;
+        return false;
     }
 
 #ifdef DEBUG
     LOG_S(INFO) << "Saved mappings to: " << path.string();
 #endif
+    return true;
+}
+
+void Mappings::SaveMappings(const char* username) {
+    std::unique_lock<std::mutex> lock(saveLock);
+    saveUser = username ? username : "";
+    dirty = 0;
+    lock.unlock();
+    WriteMappings(ALIENFX_MAP_ALL);
+}
+
+void Mappings::MarkDirty(int sections, const char* username) {
+    std::lock_guard<std::mutex> lock(saveLock);
+    if (username) saveUser = username;
+    dirty |= sections;
+    lastChange = std::chrono::steady_clock::now();
+    if (!saveThread.joinable()) {
+        saveStop = false;
+        saveThread = std::thread(&Mappings::SaveLoop, this);
+    }
+    saveCond.notify_one();
+}
+
+bool Mappings::Flush() {
+    std::unique_lock<std::mutex> lock(saveLock);
+    int sections = dirty;
+    dirty = 0;
+    lock.unlock();
+    if (!sections) {
+        // wait for write started by writer thread
+        std::lock_guard<std::mutex> wlock(writeLock);
+        return true;
+    }
+    if (WriteMappings(sections)) return true;
+    // keep it for next try
+    lock.lock();
+    dirty |= sections;
+    return false;
+}
+
+void Mappings::SaveLoop() {
+    std::unique_lock<std::mutex> lock(saveLock);
+    while (!saveStop) {
+        if (!dirty) {
+            saveCond.wait(lock);
+            continue;
+        }
+        // wait for the quiet period after last change
+        auto due = lastChange + std::chrono::milliseconds(saveDelay);
+        if (std::chrono::steady_clock::now() < due) {
+            saveCond.wait_until(lock, due);
+            continue;
+        }
+        int sections = dirty;
+        dirty = 0;
+        lock.unlock();
+        bool res = WriteMappings(sections);
+        lock.lock();
+        if (!res) {
+            // retry after next delay
+            dirty |= sections;
+            lastChange = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+bool Mappings::WatchMappings(const char* username) {
+    if (watchThread.joinable()) return true;
+    watchUser = username ? username : "";
+    const auto path = GetMappingsPath(watchUser.c_str());
+    EnsureParentDirExists(path);
+
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchFd < 0) {
+        LOG_S(ERROR) << "Failed to init inotify: " << strerror(errno);
+        return false;
+    }
+    // Watch the directory - saving replaces the file by rename
+    if (inotify_add_watch(watchFd, path.parent_path().c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        LOG_S(ERROR) << "Failed to watch " << path.parent_path().string()
+                     << ": " << strerror(errno);
+        close(watchFd);
+        watchFd = -1;
+        return false;
+    }
+    watchStop = eventfd(0, EFD_CLOEXEC);
+    selfWrites = 0;
+    watchThread = std::thread(&Mappings::WatchLoop, this);
+#ifdef DEBUG
+    LOG_S(INFO) << "Watching mappings at: " << path.string();
+#endif
+    return true;
+}
+
+void Mappings::StopWatch() {
+    if (watchThread.joinable()) {
+        uint64_t one = 1;
+        if (write(watchStop, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop mappings watch";
+        watchThread.join();
+    }
+    if (watchFd >= 0) close(watchFd);
+    if (watchStop >= 0) close(watchStop);
+    watchFd = watchStop = -1;
+}
+
+void Mappings::WatchLoop() {
+    const auto path = GetMappingsPath(watchUser.c_str());
+    const auto fname = path.filename().string();
+    alignas(inotify_event) char buffer[4096];
+    pollfd fds[2] = {{watchFd, POLLIN, 0}, {watchStop, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+        bool changed = false;
+        ssize_t len;
+        while ((len = read(watchFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + len;) {
+                auto* ev = (inotify_event*)ptr;
+                ptr += sizeof(inotify_event) + ev->len;
+                if (!ev->len || fname != ev->name) continue;
+                // skip our own saves
+                if ((ev->mask & IN_MOVED_TO) && selfWrites) {
+                    selfWrites--;
+                    continue;
+                }
+                changed = true;
+            }
+        }
+        if (changed) {
+            Afx_mapData m;
+            if (ReadMappings(path, m)) MergeMappings(m);
+        }
+    }
+}
+
+void Mappings::MergeMappings(Afx_mapData& m) {
+    int updated = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mapLock);
+        int keep;  // unsaved local changes win
+        {
+            std::lock_guard<std::mutex> slock(saveLock);
+            keep = dirty;
+            keepFile = m.newer;
+        }
+        // move names into live pool
+        auto remap = [&](Afx_nameID& id) {
+            id = names.Intern(m.names.Get(id));
+        };
+        for (auto& d : m.devs) {
+            remap(d.nameid);
+            for (auto& l : d.lights) remap(l.nameid);
+        }
+        for (auto& g : m.grps) remap(g.nameid);
+        for (auto& gr : m.grds) remap(gr.nameid);
+
+        // Device and light pointers are in use by other threads, so only
+        // update entries in place. New devices and changed light lists wait
+        // for ApplyMerged.
+        auto defer = [&](Afx_device& d) {
+            for (auto& f : fileDevs)
+                if (f.devID == d.devID) {
+                    f = std::move(d);
+                    return;
+                }
+            fileDevs.push_back(std::move(d));
+        };
+        for (auto& d : m.devs) {
+            Afx_device* cur = GetDeviceById(d.devID);
+            if (!cur) {
+                if (keep & (ALIENFX_MAP_DEVICES | ALIENFX_MAP_LIGHTS)) continue;
+                // new device, handle will be set by next enumeration
+                defer(d);
+                continue;
+            }
+            // device handle, presence and live version stay as they are
+            if (!(keep & ALIENFX_MAP_DEVICES)) {
+                cur->nameid = d.nameid;
+                cur->white = d.white;
+                cur->brightness = d.brightness;
+                updated |= ALIENFX_MAP_DEVICES;
+            }
+            if (!(keep & ALIENFX_MAP_LIGHTS)) {
+                bool same = cur->lights.size() == d.lights.size();
+                for (size_t i = 0; same && i < d.lights.size(); i++)
+                    same = cur->lights[i].lightid == d.lights[i].lightid;
+                if (same) {
+                    for (size_t i = 0; i < d.lights.size(); i++) {
+                        cur->lights[i].data = d.lights[i].data;
+                        cur->lights[i].nameid = d.lights[i].nameid;
+                    }
+                    updated |= ALIENFX_MAP_LIGHTS;
+                } else
+                    defer(d);
+            }
+        }
+        if (!(keep & ALIENFX_MAP_GROUPS)) {
+            groups = std::move(m.grps);
+            updated |= ALIENFX_MAP_GROUPS;
+        }
+        if (!(keep & ALIENFX_MAP_GRIDS)) {
+            std::swap(grids, m.grds);
+            updated |= ALIENFX_MAP_GRIDS;
+        }
+        if (updated & (ALIENFX_MAP_GROUPS | ALIENFX_MAP_GRIDS)) layoutGen++;
+        for (auto& gr : m.grds) delete[] gr.grid;
+        m.grds.clear();
+        // serialized sections are stale now
+        cache.reset();
+    }
+#ifdef DEBUG
+    LOG_S(INFO) << "Mappings reloaded, sections 0x" << std::hex << updated;
+#endif
+    if (onReload) onReload(updated);
 }
 
 Afx_light* Mappings::GetMappingByID(unsigned short pid, unsigned short lid) {
@@ -1418,5 +1936,37 @@ bool Functions::IsHaveGlobal() {
     return version == API_V5 || version == API_V8;
 }
 
+std::vector<Afx_report> Functions::DryRun(
+    const std::function<void(Functions*)>& fn) {
+    std::vector<Afx_report> out;
+    bool oldSet = inSet;
+    uint8_t oldChain = chain, oldBright = bright;
+    capture = &out;
+    captureWait = false;
+    fn(this);
+    capture = nullptr;
+    inSet = oldSet;
+    chain = oldChain;
+    bright = oldBright;
+    return out;
+}
+
+bool Functions::Replay(const std::vector<Afx_report>& reps) {
+    std::uint8_t buffer[MAX_BUFFERSIZE];
+    for (auto& r : reps) {
+        if (r.data.size() != (size_t)length) {
+            LOG_S(ERROR) << "Report size " << r.data.size()
+                         << " doesn't match device report size " << length;
+            return false;
+        }
+        if (r.flags & AFX_REPORT_WAIT) WaitForReady();
+        memcpy(buffer, r.data.data(), length);
+        if (!SendReport(buffer, r.flags & AFX_REPORT_FEATURE)) return false;
+    }
+    // captured sequences end with update
+    inSet = false;
+    return true;
+}
+
 }  // namespace AlienFX_SDK
 //
@@ -0,0 +1,318 @@
+#include "alienfx_audio.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+Afx_audio::Afx_audio(Mappings* map, const Afx_audioParams& params)
+    : map(map), params(params) {
+    // window size is rounded down to power of 2, 64 at least
+    bits = 6;
+    while ((2u << bits) <= params.fftSize && bits < 16) bits++;
+    n = 1u << bits;
+    window.resize(n);
+    ring.resize(n);
+    re.resize(n);
+    im.resize(n);
+    rev.resize(n);
+    for (unsigned i = 0; i < n; i++) {
+        window[i] = 0.5f - 0.5f * std::cos(2 * M_PI * i / (n - 1));
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        rev[i] = r;
+    }
+    // twiddles for stage with half-size h are at [h, 2h)
+    twRe.resize(n);
+    twIm.resize(n);
+    for (unsigned h = 1; h < n; h <<= 1)
+        for (unsigned k = 0; k < h; k++) {
+            twRe[h + k] = std::cos(M_PI * k / h);
+            twIm[h + k] = -std::sin(M_PI * k / h);
+        }
+    spectrum.resize(n / 2);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+Afx_audio::~Afx_audio() {
+    Close();
+    if (stopFd >= 0) close(stopFd);
+}
+
+// Read exactly len bytes, false on end of stream
+static bool ReadAll(int fd, void* buf, size_t len) {
+    for (size_t done = 0; done < len;) {
+        ssize_t r = read(fd, (uint8_t*)buf + done, len - done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        done += r;
+    }
+    return true;
+}
+
+bool Afx_audio::ReadHeader() {
+    uint8_t riff[12];
+    if (!ReadAll(fd, riff, sizeof(riff))) return false;
+    if (memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        // raw PCM, probe bytes are samples
+        pending.assign(riff, riff + sizeof(riff));
+        return true;
+    }
+    for (;;) {
+        uint8_t chunk[8];
+        if (!ReadAll(fd, chunk, sizeof(chunk))) return false;
+        uint32_t size;
+        memcpy(&size, chunk + 4, 4);
+        if (!memcmp(chunk, "data", 4)) return true;
+        std::vector<uint8_t> body(size + (size & 1));
+        if (!ReadAll(fd, body.data(), body.size())) return false;
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            uint16_t format, ch, sbits;
+            memcpy(&format, &body[0], 2);
+            memcpy(&ch, &body[2], 2);
+            memcpy(&rate, &body[4], 4);
+            memcpy(&sbits, &body[14], 2);
+            // PCM or extensible PCM
+            if ((format != 1 && format != 0xfffe) || sbits != 16 || !ch) {
+                LOG_S(ERROR) << "Unsupported WAV format " << format << ", "
+                             << sbits << " bits";
+                return false;
+            }
+            channels = ch;
+        }
+    }
+}
+
+bool Afx_audio::Open(const char* path, unsigned rate, unsigned channels,
+                     bool realtime) {
+    Close();
+    this->rate = rate;
+    this->channels = channels;
+    pending.clear();
+    fd = strcmp(path, "-") ? open(path, O_RDONLY | O_CLOEXEC) : dup(0);
+    if (fd < 0) {
+        LOG_S(ERROR) << "Failed to open audio " << path << ": "
+                     << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    // pipes are paced by writer
+    this->realtime = realtime && !fstat(fd, &st) && S_ISREG(st.st_mode);
+    if (!ReadHeader()) {
+        LOG_S(ERROR) << "Failed to read audio header from " << path;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    // frame size and timing are derived from them
+    if (!this->rate || !this->channels) {
+        LOG_S(ERROR) << "Invalid audio format " << this->rate << " Hz, "
+                     << this->channels << " channels";
+        close(fd);
+        fd = -1;
+        return false;
+    }
+#ifdef DEBUG
+    LOG_S(INFO) << "Audio " << path << ": " << this->rate << " Hz, "
+                << this->channels << " channels";
+#endif
+    reader = std::thread(&Afx_audio::ReadLoop, this);
+    return true;
+}
+
+void Afx_audio::Close() {
+    if (reader.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop audio reader";
+        reader.join();
+        // reset stop signal for reopen
+        if (read(stopFd, &one, sizeof(one)) < 0) one = 0;
+    }
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+void Afx_audio::ReadLoop() {
+    const size_t frameSize = channels * sizeof(int16_t),
+                 chunk = n / 2 * frameSize;  // one hop per read
+    std::vector<uint8_t> buf(chunk + frameSize);
+    size_t have = pending.size();
+    memcpy(buf.data(), pending.data(), have);
+    uint64_t start = Engine::Now(), played = 0;  // frames
+    pollfd fds[2]{{fd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_S(ERROR) << "Audio poll failed: " << strerror(errno);
+            return;
+        }
+        if (fds[1].revents) return;
+        ssize_t r = read(fd, buf.data() + have, chunk - have);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        have += r;
+        size_t frames = have / frameSize;
+        if (!frames) continue;
+        played += frames;
+        if (realtime) {
+            // samples are captured at the end of their play time
+            uint64_t due = start + played * 1000000 / rate,
+                     now = Engine::Now();
+            if (due > now && poll(fds + 1, 1, (due - now) / 1000) > 0) return;
+        }
+        Push((int16_t*)buf.data(), frames, Engine::Now());
+        have -= frames * frameSize;
+        memmove(buf.data(), buf.data() + frames * frameSize, have);
+    }
+#ifdef DEBUG
+    LOG_S(INFO) << "Audio stream finished, " << played << " frames";
+#endif
+}
+
+void Afx_audio::Push(const int16_t* samples, size_t frames, uint64_t time) {
+    const unsigned hop = n / 2;
+    const float scale = 1.0f / (32768.0f * channels);
+    for (size_t i = 0; i < frames; i++) {
+        int sum = 0;
+        for (unsigned c = 0; c < channels; c++)
+            sum += samples[i * channels + c];
+        ring[ringPos] = sum * scale;
+        ringPos = (ringPos + 1) & (n - 1);
+        if (++fresh >= hop) {
+            fresh = 0;
+            // capture time of the last sample in window
+            Analyze(time - (frames - 1 - i) * 1000000ull / rate);
+        }
+    }
+}
+
+void Afx_audio::Analyze(uint64_t time) {
+    uint64_t t0 = Engine::Now();
+    float* __restrict xr = re.data();
+    float* __restrict xi = im.data();
+    // windowed samples, oldest first, in bit-reversed order
+    for (unsigned i = 0; i < n; i++) {
+        xr[rev[i]] = ring[(ringPos + i) & (n - 1)] * window[i];
+        xi[i] = 0;
+    }
+    // radix-2 butterflies, inner loop runs over contiguous twiddles
+    for (unsigned h = 1; h < n; h <<= 1) {
+        const float* __restrict wr = twRe.data() + h;
+        const float* __restrict wi = twIm.data() + h;
+        for (unsigned j = 0; j < n; j += 2 * h) {
+            float* __restrict ar = xr + j;
+            float* __restrict ai = xi + j;
+            float* __restrict br = xr + j + h;
+            float* __restrict bi = xi + j + h;
+            for (unsigned k = 0; k < h; k++) {
+                float tr = br[k] * wr[k] - bi[k] * wi[k],
+                      ti = br[k] * wi[k] + bi[k] * wr[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+    // full-scale sine peaks at n/4 with Hann window, so it is 0 dB
+    const unsigned half = n / 2;
+    const float norm = 16.0f / ((float)n * n), floor = params.floorDb;
+    std::vector<float> level(half);
+    for (unsigned k = 0; k < half; k++) {
+        float p = (xr[k] * xr[k] + xi[k] * xi[k]) * norm,
+              db = 10.0f * std::log10(p + 1e-12f),
+              v = (db - floor) / -floor;
+        level[k] = v < 0 ? 0 : v > 1 ? 1 : v;
+    }
+    double used = Engine::Now() - t0;
+    std::lock_guard<std::mutex> guard(lock);
+    if (specNew) stats.overruns++;
+    spectrum.swap(level);
+    specTime = time;
+    specNew = true;
+    stats.blocks++;
+    fftSum += used;
+    stats.fftTime = fftSum / stats.blocks;
+}
+
+Afx_audioStats Afx_audio::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+static Afx_colorcode Mix(Afx_colorcode a, Afx_colorcode b, float f,
+                         float level) {
+    return {(uint8_t)((a.b + (b.b - a.b) * f) * level),
+            (uint8_t)((a.g + (b.g - a.g) * f) * level),
+            (uint8_t)((a.r + (b.r - a.r) * f) * level), 255};
+}
+
+bool Afx_audio::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    Afx_grid* grid = map->GetGridByID(params.gridID);
+    if (!grid || !grid->grid || !grid->x || !grid->y) return true;
+    const unsigned gx = grid->x, gy = grid->y;
+    // bars update once per frame, effect can be rendered for many devices
+    if (bars.size() != gx) bars.assign(gx, 0);
+    if (frame->stamp != barTime) {
+        std::lock_guard<std::mutex> guard(lock);
+        float fall = barTime && frame->stamp > barTime
+                         ? (frame->stamp - barTime) / (params.decay * 1000.0f)
+                         : 0;
+        barSource = specNew ? specTime : 0;
+        specNew = false;
+        // log-spaced bands, one per column
+        const float ratio = params.maxFreq / params.minFreq,
+                    binHz = (float)rate / n;
+        const unsigned half = n / 2;
+        for (unsigned c = 0; c < gx; c++) {
+            unsigned k0 = params.minFreq * std::pow(ratio, (float)c / gx) /
+                          binHz,
+                     k1 = params.minFreq *
+                          std::pow(ratio, (float)(c + 1) / gx) / binHz;
+            if (k0 >= half) k0 = half - 1;
+            if (k1 > half) k1 = half;
+            float v = spectrum[k0];
+            for (unsigned k = k0 + 1; k < k1; k++)
+                if (spectrum[k] > v) v = spectrum[k];
+            float down = bars[c] - fall;
+            bars[c] = v > down ? v : down > 0 ? down : 0;
+        }
+        barTime = frame->stamp;
+    }
+    if (barSource && (!frame->source || barSource < frame->source))
+        frame->source = barSource;
+    // brightest cell wins for lights spanning several cells
+    float best[AFX_FRAME_LIGHTS];
+    for (auto& b : best) b = -1;
+    for (unsigned y = 0; y < gy; y++)
+        for (unsigned x = 0; x < gx; x++) {
+            Afx_groupLight cell = grid->grid[y * gx + x];
+            if (!cell.lgh || cell.did != dev->pid ||
+                cell.lid >= AFX_FRAME_LIGHTS)
+                continue;
+            float v = bars[x], fill = 1.0f, pos = v;
+            if (params.mode == AFX_AUDIO_BARS) {
+                // row from bottom, partially lit at bar top
+                unsigned row = gy - 1 - y;
+                fill = v * gy - row;
+                fill = fill < 0 ? 0 : fill > 1 ? 1 : fill;
+                pos = gy > 1 ? (float)row / (gy - 1) : 1;
+            } else
+                fill = v;
+            if (fill <= best[cell.lid]) continue;
+            best[cell.lid] = fill;
+            frame->lights[cell.lid] = Mix(params.low, params.high, pos, fill);
+        }
+    return true;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,197 @@
+#include "alienfx_c.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <loguru.hpp>
+
+#include "alienfx_engine.h"
+
+using namespace AlienFX_SDK;
+
+struct Afx_cDevice {  // Frame state for device
+    Afx_colorcode sent[AFX_FRAME_LIGHTS]{};  // colors sent, br 0 - unknown
+    std::bitset<AFX_FRAME_LIGHTS> skip;      // power lights
+};
+
+struct afx_context {
+    Mappings map;
+    bool simulated = false;
+    std::vector<Afx_cDevice> devs;       // by device index
+    std::vector<Afx_lightblock> blocks;  // frame blocks, reused
+};
+
+// Sync frame state with device list, new devices are appended by scan
+static void Refresh(afx_context* ctx) {
+    ctx->devs.resize(ctx->map.fxdevs.size());
+    for (size_t i = 0; i < ctx->devs.size(); i++) {
+        auto& d = ctx->map.fxdevs[i];
+        auto& st = ctx->devs[i];
+        st.skip.reset();
+        for (auto& l : d.lights)
+            if (l.flags & ALIENFX_FLAG_POWER) st.skip.set(l.lightid);
+        // device could be replugged and reset
+        if (!d.present) memset(st.sent, 0, sizeof(st.sent));
+    }
+}
+
+static Afx_device* GetDevice(afx_context* ctx, int dev) {
+    if (!ctx || dev < 0 || dev >= (int)ctx->map.fxdevs.size()) return nullptr;
+    return &ctx->map.fxdevs[dev];
+}
+
+static void CopyName(char* to, size_t size, const std::string& name) {
+    strncpy(to, name.c_str(), size - 1);
+    to[size - 1] = 0;
+}
+
+// Copy filled structure into caller one, which can be older and shorter
+template <typename T>
+static void CopyInfo(T* to, T& from) {
+    from.size = to->size;
+    memcpy(to, &from, std::min<size_t>(to->size, sizeof(T)));
+}
+
+extern "C" {
+
+int afx_api_version(void) { return AFX_C_API_VERSION; }
+
+afx_context* afx_open(void) {
+    afx_context* ctx = nullptr;
+    try {
+        ctx = new afx_context;
+        ctx->map.LoadMappings();
+        ctx->map.AlienFXEnumDevices();
+        ctx->blocks.reserve(AFX_FRAME_LIGHTS);
+        Refresh(ctx);
+    } catch (const std::exception& e) {
+        LOG_S(ERROR) << "Failed to open AlienFX context: " << e.what();
+        delete ctx;
+        return nullptr;
+    }
+    return ctx;
+}
+
+afx_context* afx_open_simulated(uint32_t dev_id, int api_version,
+                                unsigned lights) {
+    if (lights > AFX_FRAME_LIGHTS) return nullptr;
+    Functions* fn = new Functions();
+    if (!fn->AlienFXSimulate(dev_id >> 16, dev_id & 0xffff, api_version)) {
+        LOG_S(ERROR) << "Can't simulate API version " << api_version;
+        delete fn;
+        return nullptr;
+    }
+    // mappings are not loaded, so they are never saved over user ones
+    afx_context* ctx = new afx_context;
+    ctx->simulated = true;
+    Afx_device* d = ctx->map.AddDeviceById(dev_id);
+    d->dev = fn;
+    d->version = api_version;
+    d->present = true;
+    d->nameid = ctx->map.names.Intern(fn->description);
+    for (unsigned i = 0; i < lights; i++) {
+        Afx_light l{};
+        l.lightid = (uint8_t)i;
+        l.nameid = ctx->map.names.Intern("Light " + std::to_string(i));
+        d->lights.push_back(l);
+    }
+    ctx->blocks.reserve(AFX_FRAME_LIGHTS);
+    Refresh(ctx);
+    return ctx;
+}
+
+void afx_close(afx_context* ctx) { delete ctx; }
+
+int afx_rescan(afx_context* ctx) {
+    if (!ctx) return AFX_ERR_ARG;
+    if (ctx->simulated) return 0;
+    bool changed = ctx->map.AlienFXEnumDevices();
+    Refresh(ctx);
+    return changed;
+}
+
+int afx_device_count(afx_context* ctx) {
+    return ctx ? (int)ctx->map.fxdevs.size() : AFX_ERR_ARG;
+}
+
+int afx_get_device_info(afx_context* ctx, int dev,
+                        afx_device_info* info) {
+    Afx_device* d = GetDevice(ctx, dev);
+    if (!d || !info || info->size < sizeof(info->size)) return AFX_ERR_ARG;
+    afx_device_info out{};
+    out.dev_id = d->devID;
+    out.vid = d->vid;
+    out.pid = d->pid;
+    out.api_version = d->version;
+    out.lights = (uint32_t)d->lights.size();
+    out.present = d->present && d->dev;
+    if (d->version > API_ACPI) {
+        out.caps = AFX_CAP_COLOR;
+        if (d->version != API_V5) out.caps |= AFX_CAP_ACTIONS;
+        if (d->version == API_V5 || d->version == API_V8)
+            out.caps |= AFX_CAP_GLOBAL;
+        if (d->version != API_V6) out.caps |= AFX_CAP_BRIGHTNESS;
+    }
+    if (ctx->simulated) out.caps |= AFX_CAP_SIMULATED;
+    std::string name = ctx->map.names.Get(d->nameid);
+    if (d->dev) {
+        out.report_length = d->dev->GetLength();
+        out.reports = d->dev->reports;
+        if (name.empty()) name = d->dev->description;
+    }
+    CopyName(out.name, sizeof(out.name), name);
+    CopyInfo(info, out);
+    return AFX_OK;
+}
+
+int afx_get_light_info(afx_context* ctx, int dev, int light,
+                       afx_light_info* info) {
+    Afx_device* d = GetDevice(ctx, dev);
+    if (!d || light < 0 || light >= (int)d->lights.size() || !info ||
+        info->size < sizeof(info->size))
+        return AFX_ERR_ARG;
+    auto& l = d->lights[light];
+    afx_light_info out{};
+    out.id = l.lightid;
+    out.flags = l.flags;
+    out.scancode = l.scancode;
+    CopyName(out.name, sizeof(out.name), ctx->map.names.Get(l.nameid));
+    CopyInfo(info, out);
+    return AFX_OK;
+}
+
+int afx_submit_rgb(afx_context* ctx, int dev, const uint8_t* rgb,
+                   unsigned count, unsigned stride) {
+    Afx_device* d = GetDevice(ctx, dev);
+    if (!stride) stride = 3;
+    if (!d || (!rgb && count) || count > AFX_FRAME_LIGHTS || stride < 3)
+        return AFX_ERR_ARG;
+    if (!d->present || !d->dev) return AFX_ERR_DEVICE;
+    auto& st = ctx->devs[dev];
+    // diff caller buffer in place, only changed lights are encoded
+    ctx->blocks.clear();
+    for (unsigned i = 0; i < count; i++, rgb += stride) {
+        Afx_colorcode c{rgb[2], rgb[1], rgb[0], 255};
+        if (st.skip[i] || st.sent[i].ci == c.ci) continue;
+        st.sent[i] = c;
+        ctx->blocks.push_back(
+            {(uint8_t)i, {{AlienFX_A_Color, 0, 0, rgb[0], rgb[1], rgb[2]}}});
+    }
+    if (ctx->blocks.empty()) return AFX_OK;
+    if (d->dev->SetMultiAction(&ctx->blocks) && d->dev->UpdateColors())
+        return AFX_OK;
+    // device state is unknown now, resend everything next time
+    memset(st.sent, 0, sizeof(st.sent));
+    return AFX_ERR_IO;
+}
+
+int afx_set_brightness(afx_context* ctx, int dev, uint8_t brightness) {
+    Afx_device* d = GetDevice(ctx, dev);
+    if (!d) return AFX_ERR_ARG;
+    if (!d->present || !d->dev) return AFX_ERR_DEVICE;
+    // true if device lost colors (v2-v3 turned on), resend them next frame
+    if (ctx->map.SetDeviceBrightness(d, brightness, false))
+        memset(ctx->devs[dev].sent, 0, sizeof(ctx->devs[dev].sent));
+    return AFX_OK;
+}
+}
@@ -0,0 +1,163 @@
+#include "alienfx_color.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AFX_X86
+#include <immintrin.h>
+#endif
+
+namespace AlienFX_SDK {
+
+void Afx_colorPipe::Setup(Afx_colorcode white, uint8_t brightness,
+                          int version, float gamma) {
+    this->white = white.ci;
+    this->brightness = brightness;
+    this->version = version;
+    this->gamma = gamma;
+    linear = gamma == 1.0f;
+    // V2/V3 devices use high 4 bits of channel only
+    if (version == API_V2 || version == API_V3) {
+        quantAdd = 8;
+        quantMask = 0xf0;
+    } else {
+        quantAdd = 0;
+        quantMask = 0xff;
+    }
+    uint8_t ch[3]{white.b, white.g, white.r};
+    for (int c = 0; c < 3; c++)
+        scale[c] = (ch[c] * brightness * 256 + 255 * 255 / 2) / (255 * 255);
+    scale[3] = 256;
+    for (int v = 0; v < 256; v++) {
+        unsigned g =
+            linear ? v : (unsigned)(powf(v / 255.0f, gamma) * 255.0f + 0.5f);
+        for (int c = 0; c < 3; c++) {
+            unsigned s = (g * scale[c] + 128) >> 8;
+            s = s + quantAdd > 255 ? 255 : s + quantAdd;
+            lut[c][v] = (s & quantMask) << (c * 8);
+        }
+    }
+}
+
+// Table lookup, any gamma
+static void ApplyLUT(const uint32_t (*lut)[256], Afx_colorcode* colors,
+                     size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t c = colors[i].ci;
+        colors[i].ci = lut[0][c & 0xff] | lut[1][(c >> 8) & 0xff] |
+                       lut[2][(c >> 16) & 0xff] | (c & 0xff000000);
+    }
+}
+
+#ifdef AFX_X86
+// Linear scale and quantization, 4 lights per step
+__attribute__((target("sse2"))) static size_t ApplyLinearSSE2(
+    const uint16_t* scale, uint8_t quantAdd, uint8_t quantMask,
+    Afx_colorcode* colors, size_t count) {
+    const __m128i k = _mm_set_epi16(scale[3], scale[2], scale[1], scale[0],
+                                    scale[3], scale[2], scale[1], scale[0]),
+                  round = _mm_set1_epi16(128), zero = _mm_setzero_si128(),
+                  qadd = _mm_set1_epi32(quantAdd * 0x10101),
+                  qmask = _mm_set1_epi32(quantMask * 0x10101),
+                  brMask = _mm_set1_epi32(0xff000000);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i* p = (__m128i*)(colors + i);
+        __m128i src = _mm_loadu_si128(p);
+        __m128i lo = _mm_unpacklo_epi8(src, zero),
+                hi = _mm_unpackhi_epi8(src, zero);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, k), round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, k), round), 8);
+        __m128i res = _mm_and_si128(
+            _mm_adds_epu8(_mm_packus_epi16(lo, hi), qadd), qmask);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_andnot_si128(brMask, res),
+                                         _mm_and_si128(brMask, src)));
+    }
+    return i;
+}
+
+// Linear scale and quantization, 8 lights per step
+__attribute__((target("avx2"))) static size_t ApplyLinearAVX2(
+    const uint16_t* scale, uint8_t quantAdd, uint8_t quantMask,
+    Afx_colorcode* colors, size_t count) {
+    const __m256i k = _mm256_set_epi16(
+                      scale[3], scale[2], scale[1], scale[0], scale[3],
+                      scale[2], scale[1], scale[0], scale[3], scale[2],
+                      scale[1], scale[0], scale[3], scale[2], scale[1],
+                      scale[0]),
+                  round = _mm256_set1_epi16(128),
+                  zero = _mm256_setzero_si256(),
+                  qadd = _mm256_set1_epi32(quantAdd * 0x10101),
+                  qmask = _mm256_set1_epi32(quantMask * 0x10101),
+                  brMask = _mm256_set1_epi32(0xff000000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i* p = (__m256i*)(colors + i);
+        __m256i src = _mm256_loadu_si256(p);
+        // unpack works per 128-bit lane, channel order is kept
+        __m256i lo = _mm256_unpacklo_epi8(src, zero),
+                hi = _mm256_unpackhi_epi8(src, zero);
+        lo = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(lo, k), round), 8);
+        hi = _mm256_srli_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(hi, k), round), 8);
+        __m256i res = _mm256_and_si256(
+            _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), qadd), qmask);
+        _mm256_storeu_si256(p,
+                            _mm256_or_si256(_mm256_andnot_si256(brMask, res),
+                                            _mm256_and_si256(brMask, src)));
+    }
+    return i;
+}
+
+// Table lookup with gathers, 8 lights per step
+__attribute__((target("avx2"))) static size_t ApplyLUTAVX2(
+    const uint32_t (*lut)[256], Afx_colorcode* colors, size_t count) {
+    const __m256i byteMask = _mm256_set1_epi32(0xff),
+                  brMask = _mm256_set1_epi32(0xff000000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i* p = (__m256i*)(colors + i);
+        __m256i src = _mm256_loadu_si256(p);
+        __m256i b = _mm256_i32gather_epi32(
+                    (const int*)lut[0], _mm256_and_si256(src, byteMask), 4),
+                g = _mm256_i32gather_epi32(
+                    (const int*)lut[1],
+                    _mm256_and_si256(_mm256_srli_epi32(src, 8), byteMask), 4),
+                r = _mm256_i32gather_epi32(
+                    (const int*)lut[2],
+                    _mm256_and_si256(_mm256_srli_epi32(src, 16), byteMask), 4);
+        _mm256_storeu_si256(
+            p, _mm256_or_si256(_mm256_or_si256(b, g),
+                               _mm256_or_si256(r, _mm256_and_si256(brMask,
+                                                                   src))));
+    }
+    return i;
+}
+#endif
+
+void Afx_colorPipe::Apply(Afx_colorcode* colors, size_t count) const {
+    size_t done = 0;
+#ifdef AFX_X86
+    if (simd >= AFX_SIMD_AVX2)
+        done = linear ? ApplyLinearAVX2(scale, quantAdd, quantMask, colors,
+                                        count)
+                      : ApplyLUTAVX2(lut, colors, count);
+    else if (simd >= AFX_SIMD_SSE2 && linear)
+        // no gathers before AVX2, so SSE2 only handles linear colors
+        done = ApplyLinearSSE2(scale, quantAdd, quantMask, colors, count);
+#endif
+    // tail and non-SIMD case, tables give the same result as linear math
+    ApplyLUT(lut, colors + done, count - done);
+}
+
+int Afx_colorPipe::Detect() {
+#ifdef AFX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return AFX_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return AFX_SIMD_SSE2;
+#endif
+    return AFX_SIMD_NONE;
+}
+
+}  // namespace AlienFX_SDK
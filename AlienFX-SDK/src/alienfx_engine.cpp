@@ -0,0 +1,504 @@
+#include "alienfx_engine.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+struct Afx_engineDev {  // Device state for scheduler
+    uint32_t devID;
+    Functions* dev;               // device control object
+    std::thread sender;           // frame sender thread
+    std::mutex lock;              // pending frame and stats lock
+    std::condition_variable cond;
+    bool stop = false;
+    bool hasPending = false;      // pending frame is not taken by sender yet
+    Afx_frame render;             // frame being rendered (scheduler thread)
+    Afx_frame pending;            // latest rendered frame
+    Afx_frame work;               // frame being sent (sender thread)
+    Afx_frame sent;               // colors set at device, unset if unknown
+    Afx_frame shown;              // copy of sent, under lock
+    std::deque<std::function<void(Functions*)>> commands;  // queued calls
+    std::vector<Afx_lightblock> blocks;  // changed lights for encoder
+    Afx_colorPipe pipe;           // device color correction
+    Afx_engineStats stats;
+    uint64_t winStart = 0;        // stats window start, us
+    unsigned winFrames = 0;       // frames into window
+    double winLat = 0, winMax = 0;
+    unsigned winSrc = 0;          // frames with source time into window
+    double winSrcLat = 0, winSrcMax = 0;
+    // overlay frame: sent before queued calls, overlay lights first
+    bool urgent = false;          // pending frame is urgent
+    uint64_t urgentCall = 0;      // Flash call time for latency, us
+    std::bitset<AFX_FRAME_LIGHTS> urgentLights;
+    // overlay state of frame being rendered (scheduler thread)
+    std::vector<std::pair<uint8_t, Afx_colorcode>> restore;  // after color
+                                                              // correction
+    std::bitset<AFX_FRAME_LIGHTS> flashLights;  // lit by overlays
+    bool flashChanged = false;  // overlay phase changed
+    uint64_t flashCall = 0;     // Flash call time of new overlay
+    bool frameSent = false;     // frame finished since last Dispatch
+};
+
+uint64_t Engine::Now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Engine::Engine(Mappings* map, unsigned fps) : map(map), fps(fps ? fps : 1) {}
+
+Engine::~Engine() { Stop(); }
+
+bool Engine::Start(bool thread) {
+    if (epollFd >= 0) return true;
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    sentFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event tev{EPOLLIN, {.fd = timerFd}}, sev{EPOLLIN, {.fd = sentFd}};
+    if (timerFd < 0 || sentFd < 0 || stopFd < 0 || epollFd < 0 ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &tev) ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, sentFd, &sev)) {
+        LOG_S(ERROR) << "Failed to create scheduler timer: "
+                     << strerror(errno);
+        Stop();
+        return false;
+    }
+    SetFPS(fps);
+    if (thread) tickThread = std::thread(&Engine::TickLoop, this);
+#ifdef DEBUG
+    LOG_S(INFO) << "Engine started at " << fps << " fps"
+                << (thread ? "" : ", external loop");
+#endif
+    return true;
+}
+
+void Engine::Stop() {
+    if (tickThread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop scheduler";
+        tickThread.join();
+    }
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        for (auto& [id, edev] : devs) StopDev(edev.get());
+        devs.clear();
+    }
+    // senders signal sentFd, so it is closed after them
+    for (int* fd : {&timerFd, &sentFd, &stopFd, &epollFd}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+void Engine::StopDev(Afx_engineDev* edev) {
+    {
+        std::lock_guard<std::mutex> dguard(edev->lock);
+        edev->stop = true;
+    }
+    edev->cond.notify_one();
+    if (edev->sender.joinable()) edev->sender.join();
+}
+
+void Engine::Release(Functions* dev) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    for (auto pos = devs.begin(); pos != devs.end();)
+        if (pos->second->dev == dev) {
+            StopDev(pos->second.get());
+            pos = devs.erase(pos);
+        } else
+            pos++;
+}
+
+bool Engine::Dispatch() {
+    if (epollFd < 0) return false;
+    uint64_t cnt;
+    if (read(timerFd, &cnt, sizeof(cnt)) == sizeof(cnt)) {
+#ifdef DEBUG
+        if (cnt > 1)
+            LOG_S(WARNING) << "Scheduler missed " << cnt - 1 << " frame(s)";
+#endif
+        Tick();
+    }
+    if (read(sentFd, &cnt, sizeof(cnt)) == sizeof(cnt)) {
+        std::vector<uint32_t> sent;
+        {
+            std::lock_guard<std::recursive_mutex> guard(lock);
+            for (auto& [id, edev] : devs) {
+                std::lock_guard<std::mutex> dguard(edev->lock);
+                if (edev->frameSent) sent.push_back(id);
+                edev->frameSent = false;
+            }
+        }
+        if (onFrameSent)
+            for (auto id : sent) onFrameSent(id);
+    }
+    return true;
+}
+
+void Engine::Flush() {
+    for (;;) {
+        bool busy = false;
+        {
+            std::lock_guard<std::recursive_mutex> guard(lock);
+            for (auto& [id, edev] : devs) {
+                std::lock_guard<std::mutex> dguard(edev->lock);
+                if (edev->hasPending || edev->commands.size()) busy = true;
+            }
+        }
+        if (!busy) return;
+        usleep(1000);
+    }
+}
+
+void Engine::SetFPS(unsigned newFps) {
+    fps = newFps ? newFps : 1;
+    if (timerFd >= 0) {
+        long period = 1000000000L / fps;
+        itimerspec its{{period / 1000000000L, period % 1000000000L},
+                       {period / 1000000000L, period % 1000000000L}};
+        timerfd_settime(timerFd, 0, &its, nullptr);
+    }
+}
+
+unsigned Engine::AddEffect(uint32_t devID,
+                           std::shared_ptr<Afx_effect> effect) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    effects.push_back({nextID, devID, effect, Now()});
+    return nextID++;
+}
+
+void Engine::RemoveEffect(unsigned id) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    for (auto pos = effects.begin(); pos != effects.end(); pos++)
+        if (pos->id == id) {
+            effects.erase(pos);
+            return;
+        }
+}
+
+void Engine::ClearEffects() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    effects.clear();
+}
+
+Afx_engineDev* Engine::GetDev(uint32_t devID, Functions* dev) {
+    auto& edev = devs[devID];
+    if (!edev) {
+        edev = std::make_unique<Afx_engineDev>();
+        edev->devID = devID;
+        edev->dev = dev;
+        edev->sent.Clear();
+        edev->sender = std::thread(&Engine::SendLoop, this, edev.get());
+    }
+    return edev.get();
+}
+
+void Engine::TickLoop() {
+    pollfd fds[2] = {{epollFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        Dispatch();
+    }
+}
+
+void Engine::Tick() {
+    std::vector<unsigned> done;
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+        uint64_t now = Now();
+        // group effects by device, keeping order
+        std::vector<std::pair<Afx_engineDev*, Afx_device*>> rendered;
+        auto start = [&](uint32_t devID, Afx_device*& dev) -> Afx_engineDev* {
+            dev = map->GetDeviceById(devID);
+            if (!dev || !dev->dev || !dev->present) return nullptr;
+            Afx_engineDev* edev = GetDev(devID, dev->dev);
+            if (std::find_if(rendered.begin(), rendered.end(),
+                             [edev](auto& r) { return r.first == edev; }) ==
+                rendered.end()) {
+                edev->render.Clear();
+                edev->render.stamp = now;
+                edev->render.source = 0;
+                rendered.push_back({edev, dev});
+            }
+            return edev;
+        };
+        Afx_device* dev;
+        for (auto& eff : effects) {
+            Afx_engineDev* edev = start(eff.devID, dev);
+            if (edev && !eff.effect->Render(dev, &edev->render,
+                                            now - eff.start))
+                done.push_back(eff.id);
+        }
+        // overlay phases, overlay devices are rendered without effects too
+        for (auto& fl : flashes) {
+            uint64_t t = now - fl.start,
+                     period = (fl.flash.on + fl.flash.off) * 1000ull;
+            int lit = fl.cancel || (fl.flash.count &&
+                                    t >= period * fl.flash.count)
+                          ? 2
+                          : !period || t % period < fl.flash.on * 1000ull;
+            fl.first = fl.lit < 0;
+            fl.changed = lit != fl.lit;
+            fl.lit = lit;
+            for (auto& [devID, lights] : fl.lights) start(devID, dev);
+        }
+        // hand frames to senders, latest frame wins
+        for (auto [edev, dev] : rendered) {
+            DrawFlashes(edev, now, false);
+            edev->pipe.Update(dev, gamma);
+            edev->pipe.Apply(edev->render.lights, AFX_FRAME_LIGHTS);
+            DrawFlashes(edev, now, true);
+            {
+                std::lock_guard<std::mutex> dguard(edev->lock);
+                if (edev->hasPending) edev->stats.dropped++;
+                edev->pending = edev->render;
+                edev->hasPending = true;
+                if (edev->flashChanged) {
+                    edev->urgent = true;
+                    edev->urgentLights |= edev->flashLights;
+                    if (!edev->urgentCall) edev->urgentCall = edev->flashCall;
+                }
+            }
+            edev->cond.notify_one();
+        }
+        for (auto id : done) RemoveEffect(id);
+        // overlays shown for the last time
+        flashes.erase(
+            std::remove_if(flashes.begin(), flashes.end(),
+                           [](auto& fl) { return fl.lit == 2; }),
+            flashes.end());
+    }
+    if (onEffectDone)
+        for (auto id : done) onEffectDone(id);
+}
+
+void Engine::DrawFlashes(Afx_engineDev* edev, uint64_t now, bool corrected) {
+    if (corrected) {
+        // colors from before overlay are corrected already
+        for (auto& [lid, c] : edev->restore) edev->render.lights[lid] = c;
+        return;
+    }
+    edev->restore.clear();
+    edev->flashLights.reset();
+    edev->flashChanged = false;
+    edev->flashCall = 0;
+    for (auto& fl : flashes) {
+        auto lights = fl.lights.find(edev->devID);
+        if (lights == fl.lights.end()) continue;
+        if (fl.changed) {
+            edev->flashChanged = true;
+            if (fl.first) edev->flashCall = fl.start;
+        }
+        for (auto& [lid, saved] : lights->second) {
+            Afx_colorcode& c = edev->render.lights[lid];
+            if (fl.lit == 1) {
+                c = fl.flash.color;
+                c.br = 255;
+                edev->flashLights[lid] = true;
+            } else if (!c.br) {
+                // not rendered by effects or other overlay
+                edev->restore.push_back(
+                    {lid, saved.br ? saved : Afx_colorcode{0, 0, 0, 255}});
+            }
+        }
+    }
+}
+
+unsigned Engine::Flash(const Afx_flash& flash) {
+    unsigned id;
+    {
+        std::lock_guard<std::recursive_mutex> guard(lock);
+        std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+        Afx_engineFlash fl{nextID, flash, Now()};
+        for (auto& gl : flash.lights)
+            for (auto& d : map->fxdevs) {
+                if (d.pid != gl.did || !d.dev || !d.present ||
+                    gl.lid >= AFX_FRAME_LIGHTS)
+                    continue;
+                // light under other overlay gets its color from before it
+                Afx_colorcode saved{};
+                bool found = false;
+                for (auto& other : flashes) {
+                    auto lights = other.lights.find(d.devID);
+                    if (lights == other.lights.end()) continue;
+                    for (auto& [lid, c] : lights->second)
+                        if (lid == gl.lid) {
+                            saved = c;
+                            found = true;
+                        }
+                }
+                if (!found) {
+                    Afx_engineDev* edev = GetDev(d.devID, d.dev);
+                    std::lock_guard<std::mutex> dguard(edev->lock);
+                    saved = edev->shown.lights[gl.lid];
+                }
+                fl.lights[d.devID].push_back({(uint8_t)gl.lid, saved});
+            }
+        if (fl.lights.empty()) return 0;
+        flashes.push_back(std::move(fl));
+        id = nextID++;
+    }
+    // out of schedule frame, so overlay does not wait for tick
+    Tick();
+    return id;
+}
+
+void Engine::CancelFlash(unsigned id) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    for (auto& fl : flashes)
+        if (fl.id == id) fl.cancel = true;
+}
+
+bool Engine::Flashing() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    return flashes.size();
+}
+
+void Engine::SendLoop(Afx_engineDev* edev) {
+    std::unique_lock<std::mutex> guard(edev->lock);
+    for (;;) {
+        edev->cond.wait(guard, [edev] {
+            return edev->stop || edev->hasPending || edev->commands.size();
+        });
+        // overlay frame goes ahead of queued calls
+        if (edev->commands.size() && !(edev->hasPending && edev->urgent)) {
+            auto cmd = std::move(edev->commands.front());
+            edev->commands.pop_front();
+            guard.unlock();
+            cmd(edev->dev);
+            guard.lock();
+            // device colors could be changed by command, and pending frame
+            // can be rendered before it
+            edev->sent.Clear();
+            edev->shown.Clear();
+            if (edev->hasPending) {
+                edev->hasPending = false;
+                edev->stats.dropped++;
+            }
+            continue;
+        }
+        if (edev->stop) break;
+        edev->work = edev->pending;
+        edev->hasPending = false;
+        const bool urgent = edev->urgent;
+        const uint64_t call = edev->urgentCall;
+        const auto first = edev->urgentLights;
+        edev->urgent = false;
+        edev->urgentCall = 0;
+        edev->urgentLights.reset();
+        guard.unlock();
+
+        // Only changed lights go to encoder, overlay lights first
+        edev->blocks.clear();
+        auto add = [edev](unsigned lid) {
+            Afx_colorcode c = edev->work.lights[lid];
+            if (!c.br || edev->sent.lights[lid].ci == c.ci) return;
+            edev->blocks.push_back(
+                {(uint8_t)lid, {{AlienFX_A_Color, 0, 0, c.r, c.g, c.b}}});
+            edev->sent.lights[lid] = c;
+        };
+        if (urgent)
+            for (unsigned lid = 0; lid < AFX_FRAME_LIGHTS; lid++)
+                if (first[lid]) add(lid);
+        for (unsigned lid = 0; lid < AFX_FRAME_LIGHTS; lid++)
+            if (!urgent || !first[lid]) add(lid);
+        uint64_t firstReport = 0;
+        bool ok = true;
+        if (edev->blocks.size()) {
+            if (call) edev->dev->reportStamp = &firstReport;
+            ok = edev->dev->SetMultiAction(&edev->blocks) &&
+                 edev->dev->UpdateColors();
+            edev->dev->reportStamp = nullptr;
+        }
+        uint64_t now = Now();
+        double lat = (now - edev->work.stamp) / 1000.0;
+
+        guard.lock();
+        if (ok)
+            for (auto& b : edev->blocks)
+                edev->shown.lights[b.index] = edev->sent.lights[b.index];
+        else
+            // device state is unknown now, resend everything next frame
+            edev->sent.Clear();
+        auto& st = edev->stats;
+        if (firstReport) {
+            double over = (firstReport - call) / 1000.0;
+            st.overlays++;
+            st.overlayLatAvg += (over - st.overlayLatAvg) / st.overlays;
+            if (over > st.overlayLatMax) st.overlayLatMax = over;
+        }
+        st.frames++;
+        if (edev->blocks.size()) st.reports++;
+        if (!edev->winStart) edev->winStart = now;
+        edev->winFrames++;
+        edev->winLat += lat;
+        if (lat > edev->winMax) edev->winMax = lat;
+        if (edev->work.source && now > edev->work.source) {
+            double src = (now - edev->work.source) / 1000.0;
+            edev->winSrc++;
+            edev->winSrcLat += src;
+            if (src > edev->winSrcMax) edev->winSrcMax = src;
+        }
+        if (now - edev->winStart >= 1000000) {
+            st.fps = edev->winFrames * 1000000.0 / (now - edev->winStart);
+            st.latAvg = edev->winLat / edev->winFrames;
+            st.latMax = edev->winMax;
+            if (edev->winSrc) {
+                st.srcLatAvg = edev->winSrcLat / edev->winSrc;
+                st.srcLatMax = edev->winSrcMax;
+            }
+            edev->winStart = now;
+            edev->winFrames = edev->winSrc = 0;
+            edev->winLat = edev->winMax = 0;
+            edev->winSrcLat = edev->winSrcMax = 0;
+        }
+        edev->frameSent = true;
+        uint64_t one = 1;
+        // Tick can be used without Start, then there is nobody to signal
+        if (sentFd >= 0 && write(sentFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to signal frame sent";
+    }
+}
+
+bool Engine::Run(uint32_t devID, std::function<void(Functions*)> cmd) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    Afx_engineDev* edev;
+    {
+        std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+        Afx_device* dev = map->GetDeviceById(devID);
+        if (!dev || !dev->dev || !dev->present) return false;
+        edev = GetDev(devID, dev->dev);
+    }
+    {
+        std::lock_guard<std::mutex> dguard(edev->lock);
+        edev->commands.push_back(std::move(cmd));
+    }
+    edev->cond.notify_one();
+    return true;
+}
+
+Afx_engineStats Engine::GetStats(uint32_t devID) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    auto pos = devs.find(devID);
+    if (pos == devs.end()) return {};
+    std::lock_guard<std::mutex> dguard(pos->second->lock);
+    return pos->second->stats;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,336 @@
+#include "alienfx_events.h"
+
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+static const char* eventNames[]{"device-added", "device-removed", "profile",
+                                "sensor", "effect-done"};
+
+std::string Afx_eventText(const Afx_event& ev) {
+    std::string text;
+    for (int i = 0; i < 5; i++)
+        if (ev.type == 1 << i) text = eventNames[i];
+    switch (ev.type) {
+        case AFX_EVENT_DEVICE_ADDED:
+        case AFX_EVENT_DEVICE_REMOVED: {
+            char id[16];
+            snprintf(id, sizeof(id), "\t0x%08x", ev.devID);
+            text += id;
+        } break;
+        case AFX_EVENT_PROFILE:
+            text += '\t' + ev.name;
+            break;
+        case AFX_EVENT_SENSOR:
+            text += '\t' + ev.name + '\t' + std::to_string(ev.value) +
+                    (ev.above ? "\tabove" : "\tbelow");
+            break;
+        case AFX_EVENT_EFFECT_DONE:
+            text += '\t' + std::to_string(ev.id);
+            break;
+    }
+    return text;
+}
+
+// Drain eventfd or timerfd
+static void Drain(int fd) {
+    uint64_t cnt;
+    if (read(fd, &cnt, sizeof(cnt)) < 0) cnt = 0;
+}
+
+// Add descriptor to poll set, false if it can't be polled
+static bool Watch(int epollFd, int fd, uint32_t events = EPOLLIN) {
+    epoll_event ev{events, {.fd = fd}};
+    return !epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void SetTimer(int fd, unsigned ms, bool periodic) {
+    timespec t{ms / 1000, (long)(ms % 1000) * 1000000};
+    itimerspec its{periodic ? t : timespec{0, 0}, t};
+    timerfd_settime(fd, 0, &its, nullptr);
+}
+
+bool Afx_events::Start(unsigned sensorPeriod, bool thread) {
+    if (epollFd >= 0) return true;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    postFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    scanFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    sensorFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epollFd < 0 || !Watch(epollFd, stopFd) || !Watch(epollFd, postFd) ||
+        !Watch(epollFd, scanFd) || !Watch(epollFd, sensorFd)) {
+        LOG_S(ERROR) << "Failed to create event poll: " << strerror(errno);
+        Stop();
+        return false;
+    }
+    SetTimer(sensorFd, sensorPeriod ? sensorPeriod : 1, true);
+
+    // kernel broadcasts uevents to group 1, no privileges needed
+    ueventFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      NETLINK_KOBJECT_UEVENT);
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if (ueventFd < 0 || bind(ueventFd, (sockaddr*)&addr, sizeof(addr)) ||
+        !Watch(epollFd, ueventFd)) {
+        LOG_S(WARNING) << "No hotplug events: " << strerror(errno);
+        if (ueventFd >= 0) close(ueventFd);
+        ueventFd = -1;
+    }
+
+    // sysfs wakes pollers with priority event on change
+    profileFd = open(AFX_EVENT_PROFILE_PATH, O_RDONLY | O_CLOEXEC);
+    if (profileFd >= 0) {
+        ReadProfile(false);
+        if (!Watch(epollFd, profileFd, EPOLLPRI | EPOLLERR)) {
+            close(profileFd);
+            profileFd = -1;
+        }
+    }
+#ifdef DEBUG
+    if (profileFd < 0) LOG_S(INFO) << "No platform profile events";
+#endif
+
+    {
+        std::lock_guard<std::recursive_mutex> guard(map->mapLock);
+        for (auto& d : map->fxdevs)
+            present[d.devID] = d.present ? d.dev : nullptr;
+    }
+    if (thread) this->thread = std::thread(&Afx_events::Loop, this);
+    return true;
+}
+
+void Afx_events::Stop() {
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop event thread";
+        thread.join();
+    }
+    for (int* fd : {&epollFd, &stopFd, &postFd, &ueventFd, &scanFd,
+                    &sensorFd, &profileFd}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+unsigned Afx_events::Subscribe(int mask,
+                               std::function<void(const Afx_event&)> cb) {
+    std::lock_guard<std::mutex> guard(lock);
+    subs.push_back({nextID, mask, std::move(cb)});
+    return nextID++;
+}
+
+void Afx_events::Unsubscribe(unsigned id) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::erase_if(subs, [id](auto& s) { return s.id == id; });
+}
+
+unsigned Afx_events::WatchSensor(const std::string& name,
+                                 std::function<int()> read, int threshold,
+                                 int hysteresis) {
+    std::lock_guard<std::mutex> guard(lock);
+    sensors.push_back(
+        {nextID, name, std::move(read), threshold, hysteresis});
+    return nextID++;
+}
+
+void Afx_events::UnwatchSensor(unsigned id) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::erase_if(sensors, [id](auto& s) { return s.id == id; });
+}
+
+void Afx_events::WatchEngine(Engine* engine) {
+    this->engine = engine;
+    auto prev = engine->onEffectDone;
+    engine->onEffectDone = [this, prev](unsigned id) {
+        if (prev) prev(id);
+        Afx_event ev;
+        ev.type = AFX_EVENT_EFFECT_DONE;
+        ev.id = id;
+        Post(ev);
+    };
+}
+
+void Afx_events::Post(const Afx_event& ev) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        posted.push_back(ev);
+    }
+    uint64_t one = 1;
+    if (postFd >= 0 && write(postFd, &one, sizeof(one)) < 0)
+        LOG_S(ERROR) << "Failed to post event";
+}
+
+void Afx_events::Emit(const Afx_event& ev) {
+    std::vector<std::function<void(const Afx_event&)>> cbs;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& s : subs)
+            if (s.mask & ev.type) cbs.push_back(s.cb);
+    }
+    // outside of lock, subscribers can subscribe or post
+    for (auto& cb : cbs) cb(ev);
+}
+
+void Afx_events::ReadUevents() {
+    char buf[8192];
+    bool scan = false;
+    for (;;) {
+        sockaddr_nl from{};
+        iovec iov{buf, sizeof(buf) - 1};
+        msghdr msg{};
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        ssize_t r = recvmsg(ueventFd, &msg, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        // kernel messages only, "action@devpath\0KEY=value\0..."
+        if (from.nl_pid) continue;
+        buf[r] = 0;
+        bool usb = false, change = false;
+        for (char* p = buf; p < buf + r; p += strlen(p) + 1) {
+            if (!strcmp(p, "SUBSYSTEM=usb") || !strcmp(p, "SUBSYSTEM=hidraw"))
+                usb = true;
+            if (!strcmp(p, "ACTION=add") || !strcmp(p, "ACTION=remove"))
+                change = true;
+        }
+        scan = scan || (usb && change);
+    }
+    // one device brings several messages, scan once they settle
+    if (scan) SetTimer(scanFd, AFX_EVENT_SCAN_DELAY, false);
+}
+
+void Afx_events::Rescan() {
+    std::map<uint32_t, Functions*> now;
+    std::vector<Functions*> gone;
+    {
+        std::lock_guard<std::recursive_mutex> guard(map->mapLock);
+        map->AlienFXEnumDevices();
+        for (auto& d : map->fxdevs) now[d.devID] = d.present ? d.dev : nullptr;
+        gone.swap(map->released);
+    }
+    // engine locks itself, then mappings, so its senders are stopped outside
+    // of mappings lock. Gone handles are not in mappings, it can't take them
+    // again.
+    for (auto dev : gone) {
+        if (engine) engine->Release(dev);
+        delete dev;
+    }
+    for (auto& [devID, dev] : now) {
+        auto pos = present.find(devID);
+        Functions* was = pos != present.end() ? pos->second : nullptr;
+        if (dev == was) continue;
+        Afx_event ev;
+        ev.devID = devID;
+        if (was) {
+            ev.type = AFX_EVENT_DEVICE_REMOVED;
+            Emit(ev);
+        }
+        if (dev) {
+            ev.type = AFX_EVENT_DEVICE_ADDED;
+            Emit(ev);
+        }
+    }
+    present = now;
+}
+
+void Afx_events::ReadProfile(bool notify) {
+    char buf[64];
+    ssize_t r = pread(profileFd, buf, sizeof(buf) - 1, 0);
+    if (r < 0) return;
+    while (r && (buf[r - 1] == '\n' || buf[r - 1] == ' ')) r--;
+    std::string name(buf, r);
+    if (name == profile) return;
+    profile = name;
+    if (notify) {
+        Afx_event ev;
+        ev.type = AFX_EVENT_PROFILE;
+        ev.name = name;
+        Emit(ev);
+    }
+}
+
+void Afx_events::PollSensors() {
+    std::vector<Afx_event> evs;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& s : sensors) {
+            int value = s.read();
+            int state = value >= s.threshold                 ? 1
+                        : value < s.threshold - s.hysteresis ? 0
+                                                             : s.state;
+            if (state == s.state) continue;
+            if (s.state >= 0 && state >= 0) {
+                Afx_event ev;
+                ev.type = AFX_EVENT_SENSOR;
+                ev.id = s.id;
+                ev.value = value;
+                ev.above = state;
+                ev.name = s.name;
+                evs.push_back(ev);
+            }
+            s.state = state;
+        }
+    }
+    for (auto& ev : evs) Emit(ev);
+}
+
+bool Afx_events::Dispatch() {
+    if (epollFd < 0) return false;
+    epoll_event evs[8];
+    int n = epoll_wait(epollFd, evs, 8, 0);
+    for (int i = 0; i < n; i++) {
+        int fd = evs[i].data.fd;
+        if (fd == stopFd) {
+            Drain(stopFd);
+            return false;
+        }
+        if (fd == ueventFd) {
+            ReadUevents();
+        } else if (fd == scanFd) {
+            Drain(scanFd);
+            Rescan();
+        } else if (fd == sensorFd) {
+            Drain(sensorFd);
+            PollSensors();
+        } else if (fd == profileFd) {
+            ReadProfile(true);
+        } else if (fd == postFd) {
+            Drain(postFd);
+            std::deque<Afx_event> queue;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                queue.swap(posted);
+            }
+            for (auto& ev : queue) Emit(ev);
+        }
+    }
+    return true;
+}
+
+void Afx_events::Loop() {
+    pollfd pfd{epollFd, POLLIN, 0};
+    for (;;) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_S(ERROR) << "Event poll failed: " << strerror(errno);
+            return;
+        }
+        if (!Dispatch()) return;
+    }
+}
+
+}  // namespace AlienFX_SDK
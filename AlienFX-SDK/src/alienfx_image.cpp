@@ -0,0 +1,331 @@
+#include "alienfx_image.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cstring>
+#include <loguru.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AFX_X86
+#include <immintrin.h>
+#endif
+
+namespace AlienFX_SDK {
+
+// Add row bytes to 32-bit sums
+static void AccumRow(uint32_t* acc, const uint8_t* row, size_t count) {
+    for (size_t i = 0; i < count; i++) acc[i] += row[i];
+}
+
+#ifdef AFX_X86
+// 16 bytes per step
+__attribute__((target("sse2"))) static size_t AccumRowSSE2(
+    uint32_t* acc, const uint8_t* row, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i src = _mm_loadu_si128((const __m128i*)(row + i)),
+                lo = _mm_unpacklo_epi8(src, zero),
+                hi = _mm_unpackhi_epi8(src, zero);
+        __m128i* p = (__m128i*)(acc + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p),
+                                          _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1),
+                                              _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(p + 2, _mm_add_epi32(_mm_loadu_si128(p + 2),
+                                              _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(p + 3, _mm_add_epi32(_mm_loadu_si128(p + 3),
+                                              _mm_unpackhi_epi16(hi, zero)));
+    }
+    return i;
+}
+
+// 32 bytes per step
+__attribute__((target("avx2"))) static size_t AccumRowAVX2(
+    uint32_t* acc, const uint8_t* row, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i* p = (__m256i*)(acc + i);
+        for (unsigned q = 0; q < 4; q++) {
+            __m256i v = _mm256_cvtepu8_epi32(
+                _mm_loadl_epi64((const __m128i*)(row + i + q * 8)));
+            _mm256_storeu_si256(p + q,
+                                _mm256_add_epi32(_mm256_loadu_si256(p + q), v));
+        }
+    }
+    return i;
+}
+#endif
+
+Afx_imageStream::Afx_imageStream(Mappings* map, uint8_t gridID)
+    : map(map), gridID(gridID), simd(Afx_colorPipe::Detect()) {
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+Afx_imageStream::~Afx_imageStream() {
+    Close();
+    if (stopFd >= 0) close(stopFd);
+}
+
+bool Afx_imageStream::Push(const uint8_t* rgb, unsigned width,
+                           unsigned height, size_t stride, uint64_t time) {
+    if (!width || !height) return false;
+    uint64_t t0 = Engine::Now();
+    {
+        std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+        Afx_grid* grid = map->GetGridByID(gridID);
+        if (!grid || !grid->x || !grid->y) return false;
+        if (grid->x != gx || grid->y != gy) {
+            gx = grid->x;
+            gy = grid->y;
+            imgW = 0;
+        }
+    }
+    if (width != imgW || height != imgH) {
+        // cell bounds, at least one pixel per cell
+        imgW = width;
+        imgH = height;
+        xb.resize(gx + 1);
+        yb.resize(gy + 1);
+        for (unsigned c = 0; c <= gx; c++) xb[c] = c * width / gx;
+        for (unsigned r = 0; r <= gy; r++) yb[r] = r * height / gy;
+        acc.resize(width * 3);
+        scaled.resize(gx * gy);
+    }
+    const size_t rowBytes = width * 3;
+    for (unsigned r = 0; r < gy; r++) {
+        unsigned y0 = yb[r], y1 = yb[r + 1] > y0 ? yb[r + 1] : y0 + 1;
+        if (y1 > height) y0 = (y1 = height) - 1;
+        // vertical sums of row band
+        memset(acc.data(), 0, rowBytes * sizeof(uint32_t));
+        for (unsigned y = y0; y < y1; y++) {
+            const uint8_t* row = rgb + y * stride;
+            size_t done = 0;
+#ifdef AFX_X86
+            if (simd >= AFX_SIMD_AVX2)
+                done = AccumRowAVX2(acc.data(), row, rowBytes);
+            else if (simd >= AFX_SIMD_SSE2)
+                done = AccumRowSSE2(acc.data(), row, rowBytes);
+#endif
+            AccumRow(acc.data() + done, row + done, rowBytes - done);
+        }
+        // horizontal sums per cell
+        for (unsigned c = 0; c < gx; c++) {
+            unsigned x0 = xb[c], x1 = xb[c + 1] > x0 ? xb[c + 1] : x0 + 1;
+            if (x1 > width) x0 = (x1 = width) - 1;
+            uint64_t sr = 0, sg = 0, sb = 0,
+                     area = (uint64_t)(x1 - x0) * (y1 - y0);
+            for (unsigned x = x0; x < x1; x++) {
+                sr += acc[x * 3];
+                sg += acc[x * 3 + 1];
+                sb += acc[x * 3 + 2];
+            }
+            scaled[r * gx + c] = {(uint8_t)((sb + area / 2) / area),
+                                  (uint8_t)((sg + area / 2) / area),
+                                  (uint8_t)((sr + area / 2) / area), 255};
+        }
+    }
+    double used = Engine::Now() - t0;
+    std::lock_guard<std::mutex> guard(lock);
+    stats.frames++;
+    scaleSum += used;
+    stats.scaleTime = scaleSum / stats.frames;
+    // unchanged image keeps lights as they are
+    unsigned changed = 0;
+    if (cells.size() != scaled.size())
+        changed = scaled.size();
+    else
+        for (size_t i = 0; i < scaled.size(); i++)
+            changed += cells[i].ci != scaled[i].ci;
+    stats.changed = changed;
+    if (!changed) return true;
+    if (cellNew) stats.dropped++;
+    cells = scaled;
+    cellTime = time;
+    cellNew = true;
+    return true;
+}
+
+bool Afx_imageStream::ReadFull(uint8_t* buf, size_t len) {
+    pollfd fds[2]{{fd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+    for (size_t done = 0; done < len;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_S(ERROR) << "Image poll failed: " << strerror(errno);
+            return false;
+        }
+        if (fds[1].revents) return false;
+        ssize_t r = read(fd, buf + done, len - done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        done += r;
+    }
+    return true;
+}
+
+bool Afx_imageStream::ReadImage(unsigned& w, unsigned& h) {
+    w = rawW;
+    h = rawH;
+    if (!rawW) {
+        // PPM header: P6, width, height, maxval, separated by whitespace and
+        // comments, single whitespace before data
+        uint8_t magic[2];
+        if (!ReadFull(magic, 2)) return false;
+        if (magic[0] != 'P' || magic[1] != '6') {
+            LOG_S(ERROR) << "Image stream is not binary PPM";
+            return false;
+        }
+        unsigned val[3];
+        for (auto& v : val) {
+            uint8_t c;
+            do {
+                if (!ReadFull(&c, 1)) return false;
+                if (c == '#')
+                    while (c != '\n')
+                        if (!ReadFull(&c, 1)) return false;
+            } while (isspace(c));
+            for (v = 0; isdigit(c);) {
+                v = v * 10 + c - '0';
+                if (!ReadFull(&c, 1)) return false;
+            }
+        }
+        w = val[0];
+        h = val[1];
+        if (val[2] != 255 || !w || !h || w > 16384 || h > 16384) {
+            LOG_S(ERROR) << "Unsupported PPM image " << w << "x" << h
+                         << ", maxval " << val[2];
+            return false;
+        }
+    }
+    image.resize(w * h * 3);
+    return ReadFull(image.data(), image.size());
+}
+
+bool Afx_imageStream::WaitUntil(uint64_t due) {
+    uint64_t now = Engine::Now();
+    pollfd pfd{stopFd, POLLIN, 0};
+    return due <= now || poll(&pfd, 1, (due - now) / 1000) <= 0;
+}
+
+void Afx_imageStream::ReadLoop() {
+    struct stat st;
+    // pipes are paced by writer
+    bool paced = fps && !fstat(fd, &st) && S_ISREG(st.st_mode);
+    uint64_t start = Engine::Now();
+    unsigned w, h;
+    for (unsigned count = 0; ReadImage(w, h); count++) {
+        if (paced && !WaitUntil(start + count * 1000000ull / fps)) return;
+        Push(image.data(), w, h, w * 3, Engine::Now());
+    }
+#ifdef DEBUG
+    LOG_S(INFO) << "Image stream finished";
+#endif
+}
+
+void Afx_imageStream::SequenceLoop() {
+    uint64_t start = Engine::Now();
+    char name[4096];
+    for (unsigned count = 0;; count++) {
+        snprintf(name, sizeof(name), pattern.c_str(), seqFirst + count);
+        fd = open(name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) break;
+        unsigned w, h;
+        bool ok = ReadImage(w, h);
+        close(fd);
+        fd = -1;
+        if (!ok || !WaitUntil(start + count * 1000000ull / fps)) break;
+        Push(image.data(), w, h, w * 3, Engine::Now());
+    }
+#ifdef DEBUG
+    LOG_S(INFO) << "Image sequence finished at " << name;
+#endif
+}
+
+bool Afx_imageStream::Open(const char* path, unsigned width, unsigned height,
+                           unsigned fps) {
+    Close();
+    fd = strcmp(path, "-") ? open(path, O_RDONLY | O_CLOEXEC) : dup(0);
+    if (fd < 0) {
+        LOG_S(ERROR) << "Failed to open image stream " << path << ": "
+                     << strerror(errno);
+        return false;
+    }
+    rawW = width && height ? width : 0;
+    rawH = rawW ? height : 0;
+    this->fps = fps;
+    reader = std::thread(&Afx_imageStream::ReadLoop, this);
+    return true;
+}
+
+bool Afx_imageStream::OpenSequence(const char* pattern, unsigned fps,
+                                   unsigned first) {
+    Close();
+    rawW = rawH = 0;
+    this->pattern = pattern;
+    this->fps = fps ? fps : 30;
+    seqFirst = first;
+    reader = std::thread(&Afx_imageStream::SequenceLoop, this);
+    return true;
+}
+
+void Afx_imageStream::Close() {
+    if (reader.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop image reader";
+        reader.join();
+        // reset stop signal for reopen
+        if (read(stopFd, &one, sizeof(one)) < 0) one = 0;
+    }
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+Afx_imageStats Afx_imageStream::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+bool Afx_imageStream::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    Afx_grid* grid = map->GetGridByID(gridID);
+    if (!grid || !grid->grid) return true;
+    const unsigned n = grid->x * grid->y;
+    // lights under several cells get average color
+    uint32_t sum[AFX_FRAME_LIGHTS][4]{};
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (cells.size() != n) return true;
+        // source time once per frame, effect can be rendered for many devices
+        if (frame->stamp != renderStamp) {
+            renderStamp = frame->stamp;
+            renderSource = cellNew ? cellTime : 0;
+            cellNew = false;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            Afx_groupLight cell = grid->grid[i];
+            if (!cell.lgh || cell.did != dev->pid ||
+                cell.lid >= AFX_FRAME_LIGHTS)
+                continue;
+            uint32_t* s = sum[cell.lid];
+            s[0] += cells[i].b;
+            s[1] += cells[i].g;
+            s[2] += cells[i].r;
+            s[3]++;
+        }
+    }
+    if (renderSource && (!frame->source || renderSource < frame->source))
+        frame->source = renderSource;
+    for (unsigned lid = 0; lid < AFX_FRAME_LIGHTS; lid++)
+        if (uint32_t k = sum[lid][3])
+            frame->lights[lid] = {(uint8_t)(sum[lid][0] / k),
+                                  (uint8_t)(sum[lid][1] / k),
+                                  (uint8_t)(sum[lid][2] / k), 255};
+    return true;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,323 @@
+#include "alienfx_input.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+// Presses are kept a bit longer than decay, so faded keys get black frame
+#define AFX_REACT_GRACE 100000
+
+static Afx_colorcode Scale(Afx_colorcode c, float level) {
+    return {(uint8_t)(c.b * level), (uint8_t)(c.g * level),
+            (uint8_t)(c.r * level), 255};
+}
+
+void Afx_reactiveEffect::Trigger(Afx_groupLight light, uint64_t time) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (params.type == AFX_REACT_HEAT) {
+        float& h = heat[light.lgh];
+        h = h + 0.25f > 1.0f ? 1.0f : h + 0.25f;
+    } else
+        presses.push_back({light, time});
+}
+
+void Afx_reactiveEffect::RenderRipples(Afx_device* dev, Afx_frame* frame) {
+    Afx_grid* grid = map->GetGridByID(params.gridID);
+    if (!grid || !grid->grid) return;
+    const uint64_t now = frame->stamp, decay = params.decay * 1000ull;
+    float level[AFX_FRAME_LIGHTS]{};
+    bool used[AFX_FRAME_LIGHTS]{};
+    const unsigned n = grid->x * grid->y;
+    for (auto& p : presses) {
+        // ripple starts at first cell of pressed light
+        unsigned pos = 0;
+        while (pos < n && grid->grid[pos].lgh != p.light.lgh) pos++;
+        if (pos == n) continue;
+        float px = pos % grid->x, py = pos / grid->x,
+              age = now > p.time ? (now - p.time) / 1000000.0f : 0,
+              fade = 1.0f - age * 1000000.0f / decay,
+              r = params.speed * age;
+        if (fade < 0) fade = 0;
+        for (unsigned i = 0; i < n; i++) {
+            Afx_groupLight cell = grid->grid[i];
+            if (!cell.lgh || cell.did != dev->pid ||
+                cell.lid >= AFX_FRAME_LIGHTS)
+                continue;
+            float dx = i % grid->x - px, dy = i / grid->x - py,
+                  v = 1.0f - std::fabs(std::sqrt(dx * dx + dy * dy) - r) /
+                                 params.width;
+            used[cell.lid] = true;
+            if (v * fade > level[cell.lid]) level[cell.lid] = v * fade;
+        }
+    }
+    for (unsigned lid = 0; lid < AFX_FRAME_LIGHTS; lid++)
+        if (used[lid]) frame->lights[lid] = Scale(params.color, level[lid]);
+}
+
+bool Afx_reactiveEffect::Render(Afx_device* dev, Afx_frame* frame,
+                                uint64_t t) {
+    std::lock_guard<std::mutex> guard(lock);
+    const uint64_t now = frame->stamp, decay = params.decay * 1000ull;
+    if (params.type == AFX_REACT_HEAT) {
+        // cool down once per frame, effect can be rendered for many devices
+        if (heatTime && now > heatTime) {
+            float f = std::exp2(-(float)(now - heatTime) / decay);
+            for (auto h = heat.begin(); h != heat.end();)
+                if ((h->second *= f) < 0.001f)
+                    h = heat.erase(h);
+                else
+                    h++;
+        }
+        heatTime = now;
+        // black - color - white scale
+        for (auto& [lgh, h] : heat) {
+            Afx_groupLight l;
+            l.lgh = lgh;
+            if (l.did != dev->pid || l.lid >= AFX_FRAME_LIGHTS) continue;
+            Afx_colorcode c = Scale(params.color, h < 0.5f ? h * 2 : 1.0f);
+            if (h > 0.5f) {
+                float w = h * 2 - 1;
+                c = {(uint8_t)(c.b + (255 - c.b) * w),
+                     (uint8_t)(c.g + (255 - c.g) * w),
+                     (uint8_t)(c.r + (255 - c.r) * w), 255};
+            }
+            frame->lights[l.lid] = c;
+        }
+        return true;
+    }
+    for (auto p = presses.begin(); p != presses.end();)
+        if (now > p->time && now - p->time > decay + AFX_REACT_GRACE)
+            p = presses.erase(p);
+        else
+            p++;
+    if (params.type == AFX_REACT_RIPPLE && params.gridID) {
+        RenderRipples(dev, frame);
+        return true;
+    }
+    for (auto& p : presses) {
+        if (p.light.did != dev->pid || p.light.lid >= AFX_FRAME_LIGHTS)
+            continue;
+        float level =
+            now > p.time ? 1.0f - (float)(now - p.time) / decay : 1.0f;
+        frame->lights[p.light.lid] =
+            Scale(params.color, level > 0 ? level : 0);
+    }
+    return true;
+}
+
+Afx_input::Afx_input(Mappings* map, Engine* engine)
+    : map(map), engine(engine) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || stopFd < 0) {
+        LOG_S(ERROR) << "Failed to create input poll: " << strerror(errno);
+        return;
+    }
+    epoll_event ev{EPOLLIN, {.fd = stopFd}};
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev);
+    BuildIndex();
+}
+
+Afx_input::~Afx_input() {
+    Stop();
+    if (epollFd >= 0) close(epollFd);
+    if (stopFd >= 0) close(stopFd);
+}
+
+void Afx_input::BuildIndex() {
+    std::unordered_map<uint16_t, std::vector<Afx_groupLight>> index;
+    {
+        std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+        for (auto& dev : map->fxdevs)
+            for (auto& l : dev.lights)
+                if (l.scancode)
+                    index[l.scancode].push_back({{dev.pid, l.lightid}});
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    keys = std::move(index);
+}
+
+bool Afx_input::AddDevice(const char* path) {
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_S(ERROR) << "Failed to open input device " << path << ": "
+                     << strerror(errno);
+        return false;
+    }
+    // event times should match engine clock
+    int clk = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clk) < 0)
+        LOG_S(WARNING) << "Can't set monotonic clock for " << path;
+    return AddFd(fd);
+}
+
+unsigned Afx_input::AddKeyboards() {
+    unsigned count = 0;
+    DIR* dir = opendir("/dev/input");
+    if (!dir) return 0;
+    while (dirent* de = readdir(dir)) {
+        if (strncmp(de->d_name, "event", 5)) continue;
+        std::string path = std::string("/dev/input/") + de->d_name;
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue;
+        uint8_t bits[KEY_MAX / 8 + 1]{};
+        bool kbd = ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(bits)), bits) >= 0 &&
+                   bits[KEY_A / 8] & (1 << (KEY_A % 8)) &&
+                   bits[KEY_SPACE / 8] & (1 << (KEY_SPACE % 8));
+        close(fd);
+        if (kbd && AddDevice(path.c_str())) count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+bool Afx_input::AddFd(int fd) {
+    epoll_event ev{EPOLLIN, {.fd = fd}};
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_S(ERROR) << "Failed to poll input: " << strerror(errno);
+        close(fd);
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    fds.push_back(fd);
+    if (!inputThread.joinable())
+        inputThread = std::thread(&Afx_input::InputLoop, this);
+    return true;
+}
+
+void Afx_input::InputLoop() {
+    epoll_event evs[16];
+    input_event buf[64];
+    for (;;) {
+        int n = epoll_wait(epollFd, evs, 16, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_S(ERROR) << "Input poll failed: " << strerror(errno);
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = evs[i].data.fd;
+            if (fd == stopFd) return;
+            for (;;) {
+                ssize_t len = read(fd, buf, sizeof(buf));
+                if (len > 0) {
+                    Process(buf, len / sizeof(input_event));
+                    continue;
+                }
+                // device removed or stream finished
+                if (!len || errno != EAGAIN)
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                break;
+            }
+        }
+    }
+}
+
+void Afx_input::Process(const input_event* events, size_t count) {
+    bool hit = false;
+    uint64_t first = 0, now = Engine::Now();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < count; i++) {
+            const input_event& ev = events[i];
+            // key down only, no autorepeat
+            if (ev.type != EV_KEY || ev.value != 1) continue;
+            stats.presses++;
+            auto pos = keys.find(ev.code);
+            if (pos == keys.end()) continue;
+            stats.mapped++;
+            uint64_t time =
+                ev.input_event_sec * 1000000ull + ev.input_event_usec;
+            if (!time || time > now) time = now;
+            if (!first || time < first) first = time;
+            for (auto& eff : effects)
+                for (auto& l : pos->second) {
+                    eff->Trigger(l, time);
+                    hit = true;
+                }
+        }
+    }
+    if (!hit) return;
+    // render and queue frame now, not at next scheduler tick
+    engine->Tick();
+    double lat = (Engine::Now() - first) / 1000.0;
+    std::lock_guard<std::mutex> guard(lock);
+    latSum += lat;
+    stats.latAvg = latSum / ++latCount;
+    if (lat > stats.latMax) stats.latMax = lat;
+}
+
+bool Afx_input::Replay(const char* path, bool realtime) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_S(ERROR) << "Failed to open event record " << path << ": "
+                     << strerror(errno);
+        return false;
+    }
+    std::vector<input_event> rec;
+    input_event buf[64];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+        rec.insert(rec.end(), buf, buf + len / sizeof(input_event));
+    close(fd);
+    uint64_t last = 0;
+    for (size_t start = 0, i = 0; i < rec.size(); i++) {
+        if (rec[i].type != EV_SYN && i + 1 < rec.size()) continue;
+        // batch ends at SYN_REPORT
+        uint64_t time =
+            rec[i].input_event_sec * 1000000ull + rec[i].input_event_usec;
+        if (realtime && last && time > last) usleep(time - last);
+        last = time;
+        uint64_t now = Engine::Now();
+        for (size_t j = start; j <= i; j++) {
+            rec[j].input_event_sec = now / 1000000;
+            rec[j].input_event_usec = now % 1000000;
+        }
+        Process(&rec[start], i + 1 - start);
+        start = i + 1;
+    }
+    return true;
+}
+
+void Afx_input::AddEffect(std::shared_ptr<Afx_reactiveEffect> effect) {
+    std::lock_guard<std::mutex> guard(lock);
+    effects.push_back(effect);
+}
+
+void Afx_input::ClearEffects() {
+    std::lock_guard<std::mutex> guard(lock);
+    effects.clear();
+}
+
+Afx_inputStats Afx_input::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+void Afx_input::Stop() {
+    if (inputThread.joinable()) {
+        uint64_t one = 1;
+        if (write(stopFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to stop input";
+        inputThread.join();
+        // reset stop signal for restart
+        if (read(stopFd, &one, sizeof(one)) < 0) one = 0;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (int fd : fds) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+    }
+    fds.clear();
+}
+
+}  // namespace AlienFX_SDK
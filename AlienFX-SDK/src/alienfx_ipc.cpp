@@ -0,0 +1,412 @@
+#include "alienfx_ipc.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+std::string Afx_ipcPath() {
+    if (const char* env = getenv(AFX_IPC_ENV)) return env;
+    if (!getuid()) return AFX_IPC_SYSTEM;
+    if (const char* run = getenv("XDG_RUNTIME_DIR"))
+        return std::string(run) + "/alienfxd.sock";
+    return "/tmp/alienfxd-" + std::to_string(getuid()) + ".sock";
+}
+
+// Fill socket address, false if path is too long
+static bool MakeAddr(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static int ConnectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!MakeAddr(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr))) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Write whole buffer, false on error
+static bool WriteAll(int fd, const std::string& data) {
+    for (size_t done = 0; done < data.size();) {
+        ssize_t w =
+            send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        done += w;
+    }
+    return true;
+}
+
+bool Afx_ipcClient::Connect(const std::string& path) {
+    Close();
+    if (path.size()) {
+        fd = ConnectTo(path);
+    } else {
+        fd = ConnectTo(Afx_ipcPath());
+        if (fd < 0 && !getenv(AFX_IPC_ENV)) fd = ConnectTo(AFX_IPC_SYSTEM);
+    }
+    return fd >= 0;
+}
+
+void Afx_ipcClient::Close() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    in.clear();
+    events.clear();
+}
+
+// Send first part of data with descriptors attached
+static bool SendFds(int fd, const std::string& data,
+                    const std::vector<int>& fds) {
+    if (fds.size() > AFX_IPC_MAXFDS) {
+        LOG_S(ERROR) << "Too many descriptors for request";
+        return false;
+    }
+    char ctl[CMSG_SPACE(sizeof(int) * AFX_IPC_MAXFDS)]{};
+    iovec iov{(void*)data.data(), data.size()};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cm), fds.data(), sizeof(int) * fds.size());
+    ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    while (w < 0 && errno == EINTR) w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    return w > 0 && WriteAll(fd, data.substr(w));
+}
+
+bool Afx_ipcClient::Request(const std::vector<std::string>& args,
+                            std::string& out, int& status,
+                            const std::vector<int>& fds) {
+    if (fd < 0) return false;
+    std::string req;
+    for (auto& a : args) {
+        if (a.find_first_of("\t\r\n") != std::string::npos) {
+            LOG_S(ERROR) << "Can't send argument with tab or line break";
+            return false;
+        }
+        if (req.size()) req += '\t';
+        req += a;
+    }
+    req += '\n';
+    if (fds.size() ? !SendFds(fd, req, fds) : !WriteAll(fd, req)) {
+        Close();
+        return false;
+    }
+    out.clear();
+    char buf[4096];
+    for (;;) {
+        // parse complete lines
+        size_t pos;
+        while ((pos = in.find('\n')) != std::string::npos) {
+            std::string line = in.substr(0, pos);
+            in.erase(0, pos + 1);
+            if (line.size() && line[0] == '|') {
+                out += line.substr(1) + '\n';
+                continue;
+            }
+            if (line.size() && line[0] == '!') {
+                events.push_back(line.substr(1));
+                continue;
+            }
+            if (line.size() > 1 && line[0] == '=') {
+                status = atoi(line.c_str() + 1);
+                return true;
+            }
+            LOG_S(ERROR) << "Broken daemon reply";
+            Close();
+            return false;
+        }
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            Close();
+            return false;
+        }
+        in.append(buf, r);
+    }
+}
+
+bool Afx_ipcClient::ReadEvent(std::string& event, int timeout) {
+    char buf[4096];
+    for (;;) {
+        size_t pos;
+        while (events.empty() && (pos = in.find('\n')) != std::string::npos) {
+            std::string line = in.substr(0, pos);
+            in.erase(0, pos + 1);
+            if (line.empty() || line[0] != '!') {
+                LOG_S(ERROR) << "Broken daemon event";
+                Close();
+                return false;
+            }
+            events.push_back(line.substr(1));
+        }
+        if (events.size()) {
+            event = std::move(events.front());
+            events.pop_front();
+            return true;
+        }
+        if (fd < 0) return false;
+        pollfd pfd{fd, POLLIN, 0};
+        int p = poll(&pfd, 1, timeout);
+        if (p < 0 && errno == EINTR) continue;
+        if (p <= 0) return false;
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            Close();
+            return false;
+        }
+        in.append(buf, r);
+    }
+}
+
+Afx_ipcServer::Afx_ipcServer() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || stopFd < 0) {
+        LOG_S(ERROR) << "Failed to create daemon poll: " << strerror(errno);
+        return;
+    }
+    epoll_event ev{EPOLLIN, {.fd = stopFd}};
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev);
+}
+
+Afx_ipcServer::~Afx_ipcServer() {
+    Close();
+    if (epollFd >= 0) close(epollFd);
+    if (stopFd >= 0) close(stopFd);
+}
+
+bool Afx_ipcServer::Listen(const std::string& path, unsigned mode,
+                           int group) {
+    Close();
+    sockaddr_un addr;
+    if (!MakeAddr(path, addr)) {
+        LOG_S(ERROR) << "Socket path too long: " << path;
+        return false;
+    }
+    int other = ConnectTo(path);
+    if (other >= 0) {
+        close(other);
+        LOG_S(ERROR) << "Other daemon is listening at " << path;
+        return false;
+    }
+    unlink(path.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    // permissions are set before listen, so nobody else can connect
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) ||
+        (group >= 0 && chown(path.c_str(), -1, group)) ||
+        chmod(path.c_str(), mode) || listen(listenFd, 16)) {
+        LOG_S(ERROR) << "Failed to listen at " << path << ": "
+                     << strerror(errno);
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    this->path = path;
+    epoll_event ev{EPOLLIN, {.fd = listenFd}};
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    return true;
+}
+
+void Afx_ipcServer::Drop(int fd) {
+    auto conn = conns.find(fd);
+    if (conn == conns.end()) return;
+    if (onClose) onClose(fd);
+    for (int f : conn->second.fds) close(f);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conns.erase(conn);
+}
+
+bool Afx_ipcServer::AddWatch(int fd, std::function<void()> cb) {
+    epoll_event ev{EPOLLIN, {.fd = fd}};
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev)) {
+        LOG_S(ERROR) << "Failed to poll descriptor: " << strerror(errno);
+        return false;
+    }
+    watches[fd] = std::move(cb);
+    return true;
+}
+
+void Afx_ipcServer::RemoveWatch(int fd) {
+    if (watches.erase(fd)) epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+bool Afx_ipcServer::Write(int fd, const std::string& data) {
+    conns[fd].out += data;
+    return Flush(fd);
+}
+
+bool Afx_ipcServer::Flush(int fd) {
+    Afx_ipcConn& conn = conns[fd];
+    size_t done = 0;
+    while (done < conn.out.size()) {
+        ssize_t w = send(fd, conn.out.data() + done, conn.out.size() - done,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (w <= 0) return false;
+        done += w;
+    }
+    conn.out.erase(0, done);
+    if (conn.out.size() > AFX_IPC_MAXQUEUE) return false;
+    // poll for space while output is left
+    bool wait = conn.out.size();
+    if (wait != conn.waiting) {
+        epoll_event ev{EPOLLIN | (wait ? EPOLLOUT : 0u), {.fd = fd}};
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+        conn.waiting = wait;
+    }
+    return true;
+}
+
+bool Afx_ipcServer::Send(int client, const std::string& event) {
+    if (!conns.count(client)) return false;
+    if (!Write(client, '!' + event + '\n')) {
+        Drop(client);
+        return false;
+    }
+    return true;
+}
+
+void Afx_ipcServer::Read(int fd, const Afx_ipcHandler& handler) {
+    Afx_ipcConn& conn = conns[fd];
+    char buf[4096];
+    char ctl[CMSG_SPACE(sizeof(int) * AFX_IPC_MAXFDS)];
+    iovec iov{buf, sizeof(buf)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    ssize_t r = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (r < 0 && errno == EINTR) return;
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+            int* rcv = (int*)CMSG_DATA(cm);
+            size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            conn.fds.insert(conn.fds.end(), rcv, rcv + n);
+        }
+    if (r <= 0 || (msg.msg_flags & MSG_CTRUNC) ||
+        conn.fds.size() > AFX_IPC_MAXFDS) {
+        Drop(fd);
+        return;
+    }
+    std::string& in = conn.in;
+    in.append(buf, r);
+    size_t pos;
+    bool ok = true;
+    while (ok && (pos = in.find('\n')) != std::string::npos) {
+        std::vector<std::string> args;
+        for (size_t s = 0, e; s < pos; s = e + 1) {
+            e = in.find('\t', s);
+            if (e > pos) e = pos;
+            args.push_back(in.substr(s, e - s));
+        }
+        in.erase(0, pos + 1);
+        std::string out, reply;
+        client = fd;
+        fds = std::move(conn.fds);
+        conn.fds.clear();
+        int status = handler(args, out);
+        for (int f : fds) close(f);
+        fds.clear();
+        client = -1;
+        // handler could drop client by failed Send
+        if (!conns.count(fd)) return;
+        // prefix every output line
+        for (size_t s = 0; s < out.size();) {
+            size_t e = out.find('\n', s);
+            if (e == std::string::npos) e = out.size();
+            reply += '|' + out.substr(s, e - s) + '\n';
+            s = e + 1;
+        }
+        reply += '=' + std::to_string(status) + '\n';
+        ok = Write(fd, reply);
+    }
+    if (!ok || in.size() > AFX_IPC_MAXLINE) Drop(fd);
+}
+
+void Afx_ipcServer::Run(const Afx_ipcHandler& handler) {
+    if (listenFd < 0) return;
+    epoll_event evs[16];
+    for (;;) {
+        int n = epoll_wait(epollFd, evs, 16, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_S(ERROR) << "Daemon poll failed: " << strerror(errno);
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = evs[i].data.fd;
+            if (fd == stopFd) {
+                uint64_t cnt;
+                if (read(stopFd, &cnt, sizeof(cnt)) < 0) cnt = 0;
+                return;
+            }
+            if (fd == listenFd) {
+                int cfd;
+                while ((cfd = accept4(listenFd, nullptr, nullptr,
+                                      SOCK_CLOEXEC)) >= 0) {
+                    epoll_event ev{EPOLLIN, {.fd = cfd}};
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, cfd, &ev);
+                    conns[cfd];
+                }
+                continue;
+            }
+            auto watch = watches.find(fd);
+            if (watch != watches.end()) {
+                // copy, callback can remove its watch
+                auto cb = watch->second;
+                cb();
+            } else if (conns.count(fd)) {
+                // hung client only gets its output queued
+                if ((evs[i].events & EPOLLOUT) && !Flush(fd))
+                    Drop(fd);
+                else if (evs[i].events & ~EPOLLOUT)
+                    Read(fd, handler);
+            }
+        }
+    }
+}
+
+void Afx_ipcServer::Stop() {
+    uint64_t one = 1;
+    if (stopFd >= 0 && write(stopFd, &one, sizeof(one)) < 0) one = 0;
+}
+
+void Afx_ipcServer::Close() {
+    while (conns.size()) Drop(conns.begin()->first);
+    while (watches.size()) RemoveWatch(watches.begin()->first);
+    if (listenFd >= 0) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+        close(listenFd);
+        unlink(path.c_str());
+    }
+    listenFd = -1;
+    path.clear();
+}
+
+}  // namespace AlienFX_SDK
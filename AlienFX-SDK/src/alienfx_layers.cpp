@@ -0,0 +1,203 @@
+#include "alienfx_layers.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace AlienFX_SDK {
+
+// Blend layer color (with opacity a) into composed channel
+static inline uint8_t Blend(int blend, uint8_t dst, uint8_t src, uint8_t a) {
+    switch (blend) {
+        case AFX_BLEND_ADD:
+            return std::min(255, dst + (src * a + 127) / 255);
+        case AFX_BLEND_MULTIPLY:
+            return (dst * (255 * 255 - a * (255 - src)) + 32512) / 65025;
+        case AFX_BLEND_MAX:
+            return std::max<int>(dst, (src * a + 127) / 255);
+        default:
+            return (dst * (255 - a) + src * a + 127) / 255;
+    }
+}
+
+Afx_compositor::Afx_layer* Afx_compositor::Find(unsigned id) {
+    for (auto& l : layers)
+        if (l.id == id) return &l;
+    return nullptr;
+}
+
+void Afx_compositor::Invalidate(const Afx_layer& layer) {
+    for (auto& [devID, ld] : layer.devs)
+        comp[devID].dirty |= layer.masked ? ld.set & ld.mask : ld.set;
+}
+
+void Afx_compositor::Sort() {
+    std::stable_sort(layers.begin(), layers.end(),
+                     [](const Afx_layer& a, const Afx_layer& b) {
+                         return a.priority < b.priority;
+                     });
+}
+
+void Afx_compositor::Store(const Afx_layer& layer, Afx_layerDev& ld,
+                           Afx_compDev& cd, uint8_t lid, Afx_colorcode c) {
+    if (ld.lights[lid].ci == c.ci) return;
+    ld.lights[lid] = c;
+    ld.set[lid] = c.br;
+    if (!layer.masked || ld.mask[lid]) cd.dirty[lid] = true;
+}
+
+unsigned Afx_compositor::AddLayer(int priority, int blend) {
+    std::lock_guard<std::mutex> guard(lock);
+    layers.push_back({nextID, priority, blend});
+    Sort();
+    return nextID++;
+}
+
+void Afx_compositor::RemoveLayer(unsigned id) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto l = layers.begin(); l != layers.end(); l++)
+        if (l->id == id) {
+            Invalidate(*l);
+            layers.erase(l);
+            return;
+        }
+}
+
+bool Afx_compositor::SetPriority(unsigned id, int priority) {
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l) return false;
+    if (l->priority != priority) {
+        l->priority = priority;
+        Invalidate(*l);
+        Sort();
+    }
+    return true;
+}
+
+bool Afx_compositor::SetBlend(unsigned id, int blend) {
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l || blend < 0 || blend >= AFX_BLEND_COUNT) return false;
+    if (l->blend != blend) {
+        l->blend = blend;
+        Invalidate(*l);
+    }
+    return true;
+}
+
+bool Afx_compositor::SetMask(unsigned id,
+                             const std::vector<Afx_groupLight>& lights) {
+    std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l) return false;
+    Invalidate(*l);
+    for (auto& [devID, ld] : l->devs) ld.mask.reset();
+    for (auto& gl : lights)
+        for (auto& d : map->fxdevs)
+            if (d.pid == gl.did && gl.lid < AFX_FRAME_LIGHTS)
+                l->devs[d.devID].mask[gl.lid] = true;
+    l->masked = lights.size();
+    Invalidate(*l);
+    return true;
+}
+
+bool Afx_compositor::SetLight(unsigned id, uint32_t devID, uint8_t lid,
+                              Afx_colorcode c) {
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l) return false;
+    Store(*l, l->devs[devID], comp[devID], lid, c);
+    return true;
+}
+
+bool Afx_compositor::SetGroup(unsigned id, unsigned gid, Afx_colorcode c) {
+    std::lock_guard<std::recursive_mutex> mguard(map->mapLock);
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    Afx_group* grp = map->GetGroupById(gid);
+    if (!l || !grp) return false;
+    for (auto& gl : grp->lights)
+        for (auto& d : map->fxdevs)
+            if (d.pid == gl.did && gl.lid < AFX_FRAME_LIGHTS)
+                Store(*l, l->devs[d.devID], comp[d.devID], (uint8_t)gl.lid,
+                      c);
+    return true;
+}
+
+bool Afx_compositor::ClearLayer(unsigned id) {
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l) return false;
+    Invalidate(*l);
+    for (auto& [devID, ld] : l->devs) {
+        memset(ld.lights, 0, sizeof(ld.lights));
+        ld.set.reset();
+    }
+    return true;
+}
+
+bool Afx_compositor::SetSource(unsigned id, uint32_t devID,
+                               std::shared_ptr<Afx_effect> source) {
+    std::lock_guard<std::mutex> guard(lock);
+    Afx_layer* l = Find(id);
+    if (!l) return false;
+    Afx_layerDev& ld = l->devs[devID];
+    ld.source = source;
+    ld.start = Engine::Now();
+    return true;
+}
+
+Afx_compositorStats Afx_compositor::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+bool Afx_compositor::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    std::lock_guard<std::mutex> guard(lock);
+    const uint32_t devID = dev->devID;
+    Afx_compDev& cd = comp[devID];
+    // layers showing on device, by priority
+    std::vector<std::pair<const Afx_layer*, const Afx_layerDev*>> shown;
+    for (auto& l : layers) {
+        auto ld = l.devs.find(devID);
+        if (ld == l.devs.end()) continue;
+        if (ld->second.source) {
+            // source frame goes into layer, changed lights only
+            Afx_frame src;
+            src.Clear();
+            src.stamp = frame->stamp;
+            if (!ld->second.source->Render(dev, &src,
+                                           frame->stamp - ld->second.start))
+                ld->second.source.reset();
+            for (int i = 0; i < AFX_FRAME_LIGHTS; i++)
+                Store(l, ld->second, cd, i, src.lights[i]);
+            if (src.source && (!frame->source || src.source < frame->source))
+                frame->source = src.source;
+        }
+        shown.push_back({&l, &ld->second});
+    }
+    for (int i = 0; i < AFX_FRAME_LIGHTS; i++) {
+        if (!cd.dirty[i]) continue;
+        Afx_colorcode res{0, 0, 0, 255};
+        bool covered = false;
+        for (auto [l, ld] : shown) {
+            Afx_colorcode c = ld->lights[i];
+            if (!c.br || (l->masked && !ld->mask[i])) continue;
+            res.r = Blend(l->blend, res.r, c.r, c.br);
+            res.g = Blend(l->blend, res.g, c.g, c.br);
+            res.b = Blend(l->blend, res.b, c.b, c.br);
+            covered = true;
+        }
+        cd.out[i] = res;
+        if (covered) cd.owned[i] = true;
+        stats.recomputed++;
+    }
+    cd.dirty.reset();
+    for (int i = 0; i < AFX_FRAME_LIGHTS; i++)
+        if (cd.owned[i]) frame->lights[i] = cd.out[i];
+    stats.frames++;
+    return true;
+}
+
+}  // namespace AlienFX_SDK
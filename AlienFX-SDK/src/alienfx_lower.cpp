@@ -0,0 +1,156 @@
+#include "alienfx_lower.h"
+
+#include "alienfx_soft.h"
+
+namespace AlienFX_SDK {
+
+#define AFX_T(t) (1 << AlienFX_A_##t)
+
+// Per-light effects and phases by API version, from device encoders
+static const Afx_caps capsList[]{
+    /* ACPI */ {AFX_T(Color), 1, false},
+    /* v1 */ {0, 0, false},
+    /* v2 */ {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph), 3, false},
+    /* v3 */ {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph), 3, false},
+    /* v4 */
+    {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph) | AFX_T(Breathing) |
+         AFX_T(Spectrum) | AFX_T(Rainbow),
+     3, false},
+    // v5 encoder only takes first phase color
+    /* v5 */ {AFX_T(Color), 1, true},
+    /* v6 */
+    {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph) | AFX_T(Breathing), 2, false},
+    /* v7 */
+    {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph) | AFX_T(Breathing) |
+         AFX_T(Spectrum) | AFX_T(Rainbow),
+     3, false},
+    // v8 data block holds first and last phase colors
+    /* v8 */
+    {AFX_T(Color) | AFX_T(Pulse) | AFX_T(Morph) | AFX_T(Breathing) |
+         AFX_T(Spectrum) | AFX_T(Rainbow),
+     2, true}};
+
+const Afx_caps& GetCaps(int version) {
+    static const Afx_caps none{0, 0, false};
+    return version >= 0 && version <= API_V8 ? capsList[version] : none;
+}
+
+bool HasHardwareActions(int version, const Afx_actions& act) {
+    const Afx_caps& caps = GetCaps(version);
+    if (act.empty() || act.size() > caps.phases) return false;
+    // color sequences are not supported, encoders take first color only
+    if (act.size() > 1 && act.front().type == AlienFX_A_Color) return false;
+    for (auto& a : act)
+        // unknown types (from callers or mappings) can't be shifted in
+        if (a.type > AlienFX_A_Power || !(caps.types & (1u << a.type)))
+            return false;
+    return true;
+}
+
+// Start device-wide effect, up to 2 colors
+static bool SetGlobal(Functions* dev, const Afx_effectDesc& desc) {
+    Afx_colorcode c1{}, c2{};
+    if (desc.colors.size()) c1 = desc.colors.front();
+    if (desc.colors.size() > 1) c2 = desc.colors[1];
+    // 3 colors means spectrum
+    uint8_t nc = desc.colors.empty() ? 3 : desc.colors.size() > 1 ? 2 : 1;
+    return dev->SetGlobalEffects(desc.globalType, desc.globalMode, nc,
+                                 desc.tempo, c1, c2);
+}
+
+Afx_lowered EffectCompiler::Compile(Afx_device* dev,
+                                    const Afx_effectDesc& desc) {
+    Afx_lowered plan;
+    if (!dev || !dev->dev || !dev->present) return plan;
+    const Afx_caps& caps = GetCaps(dev->version);
+
+    std::vector<uint8_t> lights = desc.lights;
+    if (lights.empty())
+        for (auto& l : dev->lights)
+            if (!(l.flags & ALIENFX_FLAG_POWER)) lights.push_back(l.lightid);
+    if (lights.empty()) return plan;
+
+    Afx_actions phases;
+    for (auto& c : desc.colors)
+        phases.push_back({desc.type, desc.time, desc.tempo, c.r, c.g, c.b});
+    if (phases.empty())
+        phases.push_back({desc.type, desc.time, desc.tempo, 255, 255, 255});
+
+    // Breathing is a morph to black and back on devices without it
+    Afx_actions hw = phases;
+    if (desc.type == AlienFX_A_Breathing &&
+        !(caps.types & AFX_T(Breathing)) && caps.types & AFX_T(Morph)) {
+        hw.clear();
+        for (auto& p : phases) {
+            hw.push_back({AlienFX_A_Morph, p.time, p.tempo, p.r, p.g, p.b});
+            hw.push_back({AlienFX_A_Morph, p.time, p.tempo, 0, 0, 0});
+        }
+    }
+    bool hwOk = HasHardwareActions(dev->version, hw);
+
+    std::vector<Afx_lightblock> softBlocks, frame;
+    for (auto lid : lights) {
+        softBlocks.push_back({lid, phases});
+        frame.push_back({lid, {{AlienFX_A_Color, 0, 0, 0, 0, 0}}});
+    }
+    // software worst case - every light changes every frame
+    Functions* fn = dev->dev;
+    plan.softPacketsPerSec =
+        (double)fps * fn->DryRun([&frame](Functions* f) {
+                            f->SetMultiAction(&frame);
+                            f->UpdateColors();
+                        }).size();
+
+    unsigned hwPackets = 0, globalPackets = 0;
+    if (hwOk) {
+        for (auto lid : lights) plan.blocks.push_back({lid, hw});
+        hwPackets = fn->DryRun([&plan](Functions* f) {
+                          f->SetMultiAction(&plan.blocks);
+                          f->UpdateColors();
+                      }).size();
+    }
+    bool globalOk = caps.global && desc.globalType && desc.lights.empty();
+    if (globalOk)
+        globalPackets =
+            fn->DryRun([&desc](Functions* f) { SetGlobal(f, desc); }).size();
+
+    if (globalOk && (!hwOk || globalPackets <= hwPackets)) {
+        plan.method = AFX_LOWER_GLOBAL;
+        plan.setupPackets = globalPackets;
+        plan.blocks.clear();
+    } else if (hwOk) {
+        plan.method = AFX_LOWER_HARDWARE;
+        plan.setupPackets = hwPackets;
+    } else {
+        plan.method = AFX_LOWER_SOFTWARE;
+        plan.packetsPerSec = plan.softPacketsPerSec;
+        plan.blocks = std::move(softBlocks);
+        plan.effect = std::make_shared<Afx_actionEffect>(plan.blocks);
+    }
+    plan.desc = desc;
+    return plan;
+}
+
+bool EffectCompiler::Apply(Afx_device* dev, Afx_lowered& plan) {
+    if (!dev || !dev->dev) return false;
+    unsigned long before = dev->dev->reports;
+    bool res = false;
+    switch (plan.method) {
+        case AFX_LOWER_GLOBAL:
+            res = SetGlobal(dev->dev, plan.desc);
+            break;
+        case AFX_LOWER_HARDWARE:
+            res = dev->dev->SetMultiAction(&plan.blocks) &&
+                  dev->dev->UpdateColors();
+            break;
+        case AFX_LOWER_SOFTWARE:
+            if (!engine) break;
+            plan.effectID = engine->AddEffect(dev->devID, plan.effect);
+            res = true;
+            break;
+    }
+    plan.sentPackets = dev->dev->reports - before;
+    return res;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,219 @@
+#include "alienfx_scene.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <loguru.hpp>
+
+#include "alienfx_color.h"
+
+namespace AlienFX_SDK {
+
+// FNV-1a, 64 bit
+static void Hash(uint64_t& h, const void* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= ((const uint8_t*)data)[i];
+        h *= 0x100000001b3ull;
+    }
+}
+
+Afx_sceneCache::Afx_sceneCache(const char* dir) {
+    if (!dir) return;
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec)
+        LOG_S(ERROR) << "Failed to create scene directory " << dir << ": "
+                     << ec.message();
+    else
+        this->dir = dir;
+}
+
+uint64_t Afx_sceneCache::Key(const Afx_device* dev,
+                             const std::vector<Afx_lightblock>& blocks) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    // device type and settings
+    const Functions* fn = dev->dev;
+    int32_t id[3]{(int32_t)fn->devID, fn->version, (int32_t)fn->GetLength()};
+    Hash(h, id, sizeof(id));
+    Hash(h, &dev->white.ci, sizeof(dev->white.ci));
+    // V6/V7 encode brightness into color reports
+    Hash(h, &fn->bright, 1);
+    for (auto& l : dev->lights) {
+        Hash(h, &l.lightid, 1);
+        Hash(h, &l.flags, sizeof(l.flags));
+    }
+    // scene itself
+    for (auto& b : blocks) {
+        Hash(h, &b.index, 1);
+        for (auto& a : b.act) Hash(h, &a, sizeof(Afx_action));
+        Hash(h, "|", 1);
+    }
+    return h;
+}
+
+// Scene names are file name parts, they can't leave storage directory
+static bool ValidName(const std::string& name) {
+    if (name.empty() || name[0] == '.' ||
+        name.find('/') != std::string::npos) {
+        LOG_S(ERROR) << "Invalid scene name: " << name;
+        return false;
+    }
+    return true;
+}
+
+std::string Afx_sceneCache::Path(const std::string& name,
+                                 const Afx_device* dev) const {
+    char id[16];
+    snprintf(id, sizeof(id), "-%04x%04x", dev->vid, dev->pid);
+    return dir + "/" + name + id + ".afxs";
+}
+
+bool Afx_sceneCache::Load(const std::string& name, const Afx_device* dev,
+                          uint64_t key, Afx_scene& sc) {
+    if (dir.empty()) return false;
+    std::ifstream in(Path(name, dev), std::ios::binary);
+    Afx_sceneHeader hdr;
+    if (!in.read((char*)&hdr, sizeof(hdr)) || hdr.magic != AFX_SCENE_MAGIC ||
+        hdr.version != AFX_SCENE_VERSION || hdr.key != key ||
+        hdr.devID != dev->dev->devID || hdr.api != dev->dev->version ||
+        hdr.length != dev->dev->GetLength())
+        return false;
+    std::vector<Afx_report> reports(hdr.count);
+    for (auto& r : reports) {
+        r.data.resize(hdr.length);
+        if (!in.read((char*)&r.flags, 1) ||
+            !in.read((char*)r.data.data(), hdr.length))
+            return false;
+    }
+    sc.key = key;
+    sc.reports = std::move(reports);
+    return true;
+}
+
+bool Afx_sceneCache::Store(const std::string& name, const Afx_device* dev,
+                           const Afx_scene& sc) {
+    Afx_sceneHeader hdr;
+    hdr.length = dev->dev->GetLength();
+    hdr.devID = dev->dev->devID;
+    hdr.api = dev->dev->version;
+    hdr.key = sc.key;
+    hdr.count = sc.reports.size();
+    // Write temp then rename, so readers never see partial scene
+    const std::string path = Path(name, dev), tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            LOG_S(ERROR) << "Failed to open scene for writing: " << tmp;
+            return false;
+        }
+        out.write((const char*)&hdr, sizeof(hdr));
+        for (auto& r : sc.reports) {
+            out.write((const char*)&r.flags, 1);
+            out.write((const char*)r.data.data(), hdr.length);
+        }
+        if (!out.good()) {
+            LOG_S(ERROR) << "Failed to write scene: " << tmp;
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), path.c_str())) {
+        LOG_S(ERROR) << "Failed to move scene into place: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+const std::vector<Afx_report>* Afx_sceneCache::Find(
+    const std::string& name, Afx_device* dev,
+    const std::vector<Afx_lightblock>& blocks) {
+    std::lock_guard<std::mutex> guard(lock);
+    return Get(name, dev, blocks);
+}
+
+const std::vector<Afx_report>* Afx_sceneCache::Get(
+    const std::string& name, Afx_device* dev,
+    const std::vector<Afx_lightblock>& blocks) {
+    Functions* fn = dev->dev;
+    if (!fn || fn->version == API_UNKNOWN || !ValidName(name)) return nullptr;
+    uint64_t key = Key(dev, blocks);
+    Afx_scene& sc = scenes[{name, dev->devID}];
+    if (sc.key == key && sc.reports.size()) {
+        stats.hits++;
+        return &sc.reports;
+    }
+    if (Load(name, dev, key, sc)) {
+        stats.loaded++;
+        return &sc.reports;
+    }
+    // encode with device colors, as engine does
+    std::vector<Afx_lightblock> act = blocks;
+    Afx_colorPipe pipe;
+    pipe.Update(dev);
+    for (auto& b : act)
+        for (auto& a : b.act) {
+            Afx_colorcode c{a.b, a.g, a.r, 255};
+            pipe.Apply(&c, 1);
+            a.r = c.r;
+            a.g = c.g;
+            a.b = c.b;
+        }
+    sc.key = key;
+    sc.reports = fn->DryRun([&act](Functions* f) {
+        f->SetMultiAction(&act);
+        f->UpdateColors();
+    });
+    stats.compiled++;
+    if (!dir.empty()) Store(name, dev, sc);
+#ifdef DEBUG
+    LOG_S(INFO) << "Scene " << name << " compiled for device 0x" << std::hex
+                << dev->devID << std::dec << ": " << sc.reports.size()
+                << " reports";
+#endif
+    return &sc.reports;
+}
+
+bool Afx_sceneCache::Apply(const std::string& name, Afx_device* dev,
+                           const std::vector<Afx_lightblock>& blocks) {
+    std::vector<Afx_report> reports;
+    {
+        // copy, scene can be compiled again by other thread while sending
+        std::lock_guard<std::mutex> guard(lock);
+        const std::vector<Afx_report>* sc = Get(name, dev, blocks);
+        if (!sc) return false;
+        reports = *sc;
+    }
+    return dev->dev->Replay(reports);
+}
+
+void Afx_sceneCache::Remove(const std::string& name) {
+    if (!ValidName(name)) return;
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto sc = scenes.begin(); sc != scenes.end();)
+        if (sc->first.first == name)
+            sc = scenes.erase(sc);
+        else
+            sc++;
+    if (dir.empty()) return;
+    std::error_code ec;
+    const std::string prefix = name + "-";
+    for (auto& f : std::filesystem::directory_iterator(dir, ec)) {
+        std::string file = f.path().filename().string();
+        // name-VVVVPPPP.afxs
+        if (file.size() == prefix.size() + 13 && !file.find(prefix) &&
+            f.path().extension() == ".afxs")
+            std::filesystem::remove(f.path(), ec);
+    }
+}
+
+void Afx_sceneCache::Clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    scenes.clear();
+}
+
+Afx_sceneStats Afx_sceneCache::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,165 @@
+#include "alienfx_shm.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+#define AFX_SHM_SEALS (F_SEAL_SHRINK | F_SEAL_GROW)
+
+bool Afx_shmWriter::Create() {
+    Close();
+    memFd = memfd_create("alienfx-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // Sealed size lets daemon map ring without SIGBUS risk
+    if (memFd < 0 || eventFd < 0 ||
+        ftruncate(memFd, sizeof(Afx_shmHeader)) ||
+        fcntl(memFd, F_ADD_SEALS, AFX_SHM_SEALS | F_SEAL_SEAL)) {
+        LOG_S(ERROR) << "Failed to create frame ring: " << strerror(errno);
+        Close();
+        return false;
+    }
+    void* mem = mmap(nullptr, sizeof(Afx_shmHeader), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, memFd, 0);
+    if (mem == MAP_FAILED) {
+        LOG_S(ERROR) << "Failed to map frame ring: " << strerror(errno);
+        Close();
+        return false;
+    }
+    // memfd is zero filled, so counters and frames are clear already
+    hdr = (Afx_shmHeader*)mem;
+    hdr->magic = AFX_SHM_MAGIC;
+    hdr->version = AFX_SHM_VERSION;
+    hdr->slots = AFX_SHM_SLOTS;
+    return true;
+}
+
+void Afx_shmWriter::Close() {
+    if (hdr) munmap(hdr, sizeof(Afx_shmHeader));
+    if (memFd >= 0) close(memFd);
+    if (eventFd >= 0) close(eventFd);
+    hdr = nullptr;
+    memFd = eventFd = -1;
+}
+
+Afx_colorcode* Afx_shmWriter::Begin() {
+    if (!hdr) return nullptr;
+    Afx_shmFrame& f =
+        hdr->frame[hdr->head.load(std::memory_order_relaxed) % AFX_SHM_SLOTS];
+    f.seq.store(f.seq.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return f.lights;
+}
+
+void Afx_shmWriter::Commit(uint64_t time) {
+    if (!hdr) return;
+    Afx_shmFrame& f =
+        hdr->frame[hdr->head.load(std::memory_order_relaxed) % AFX_SHM_SLOTS];
+    f.time = time;
+    f.seq.store(f.seq.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+    hdr->head.fetch_add(1);
+    // pairs with reader arming, then checking head in Wake
+    if (hdr->armed.exchange(0)) {
+        uint64_t one = 1;
+        if (write(eventFd, &one, sizeof(one)) < 0)
+            LOG_S(ERROR) << "Failed to signal frame ring";
+    }
+}
+
+Afx_shmReader::~Afx_shmReader() {
+    if (hdr) munmap(hdr, sizeof(Afx_shmHeader));
+    if (memFd >= 0) close(memFd);
+    if (eventFd >= 0) close(eventFd);
+}
+
+bool Afx_shmReader::Attach(int memFd, int eventFd) {
+    this->memFd = memFd;
+    this->eventFd = eventFd;
+    struct stat st;
+    int seals = fcntl(memFd, F_GET_SEALS);
+    if (seals < 0 || (seals & AFX_SHM_SEALS) != AFX_SHM_SEALS ||
+        fstat(memFd, &st) || st.st_size < (off_t)sizeof(Afx_shmHeader)) {
+        LOG_S(ERROR) << "Frame ring is not a sealed memfd of right size";
+        return false;
+    }
+    void* mem = mmap(nullptr, sizeof(Afx_shmHeader), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, memFd, 0);
+    if (mem == MAP_FAILED) {
+        LOG_S(ERROR) << "Failed to map frame ring: " << strerror(errno);
+        return false;
+    }
+    hdr = (Afx_shmHeader*)mem;
+    if (hdr->magic != AFX_SHM_MAGIC || hdr->version != AFX_SHM_VERSION ||
+        hdr->slots != AFX_SHM_SLOTS) {
+        LOG_S(ERROR) << "Unknown frame ring layout";
+        return false;
+    }
+    rendered = hdr->head.load();
+    hdr->tail.store(rendered);
+    hdr->armed.store(1);
+    return true;
+}
+
+bool Afx_shmReader::Fetch() {
+    Afx_colorcode tmp[AFX_FRAME_LIGHTS];
+    for (int tries = 0; tries < 8; tries++) {
+        uint32_t h = hdr->head.load(std::memory_order_acquire);
+        if (h == rendered) return false;
+        Afx_shmFrame& f = hdr->frame[(h - 1) % AFX_SHM_SLOTS];
+        uint32_t seq = f.seq.load(std::memory_order_acquire);
+        if (!(seq & 1)) {
+            memcpy(tmp, f.lights, sizeof(tmp));
+            uint64_t time = f.time;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (f.seq.load(std::memory_order_relaxed) == seq) {
+                memcpy(last, tmp, sizeof(last));
+                lastTime = time;
+                stats.frames++;
+                stats.skipped += h - rendered - 1;
+                rendered = h;
+                hdr->taken.store(stats.frames);
+                hdr->tail.store(h, std::memory_order_release);
+                return true;
+            }
+        }
+        // writer lapped the ring while we copied
+        stats.retries++;
+    }
+    return false;
+}
+
+bool Afx_shmReader::Wake() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!hdr) return false;
+    uint64_t cnt;
+    if (read(eventFd, &cnt, sizeof(cnt)) == sizeof(cnt)) stats.wakeups++;
+    hdr->armed.store(1);
+    return hdr->head.load() != rendered;
+}
+
+Afx_shmStats Afx_shmReader::GetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+bool Afx_shmReader::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!hdr) return false;
+    // input time only for fresh frames, repeats are not new input
+    if (Fetch() && lastTime &&
+        (!frame->source || lastTime < frame->source))
+        frame->source = lastTime;
+    for (int i = 0; i < AFX_FRAME_LIGHTS; i++)
+        if (last[i].br) frame->lights[i] = last[i];
+    return true;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,135 @@
+#include "alienfx_soft.h"
+
+#include "alienfx_lower.h"
+
+namespace AlienFX_SDK {
+
+// Full-saturation color for hue (0..1) and value
+static Afx_colorcode Hue(float h, uint8_t v) {
+    float x = (h - (int)h) * 6.0f, f = x - (int)x;
+    uint8_t up = (uint8_t)(v * f), down = (uint8_t)(v * (1.0f - f));
+    switch ((int)x) {
+        case 0:
+            return {0, up, v, 255};
+        case 1:
+            return {0, v, down, 255};
+        case 2:
+            return {up, v, 0, 255};
+        case 3:
+            return {v, down, 0, 255};
+        case 4:
+            return {v, 0, up, 255};
+        default:
+            return {down, 0, v, 255};
+    }
+}
+
+static Afx_colorcode Mix(const Afx_action& a, const Afx_action& b, float f) {
+    return {(uint8_t)(a.b + (b.b - a.b) * f), (uint8_t)(a.g + (b.g - a.g) * f),
+            (uint8_t)(a.r + (b.r - a.r) * f), 255};
+}
+
+Afx_colorcode Afx_actionEffect::Eval(const Afx_lightblock& block,
+                                     uint64_t t) {
+    if (block.act.empty()) return {};
+    // phase lengths, us
+    uint64_t total = 0;
+    for (auto& a : block.act)
+        total += (a.time * 50 + 64 + (255 - a.tempo) * 8) * 1000ull;
+    uint64_t tau = t % total;
+    size_t i = 0;
+    const Afx_action* a = &block.act[0];
+    for (;; a = &block.act[++i]) {
+        uint64_t len = (a->time * 50 + 64 + (255 - a->tempo) * 8) * 1000ull;
+        if (tau < len || i + 1 == block.act.size()) break;
+        tau -= len;
+    }
+    // single phase morphs to black and back
+    static const Afx_action black{};
+    const Afx_action& next = block.act.size() > 1
+                                 ? block.act[(i + 1) % block.act.size()]
+                                 : black;
+    uint64_t hold = a->time * 50000ull,
+             trans = (64 + (255 - a->tempo) * 8) * 1000ull;
+    float x = (float)tau / (hold + trans);  // phase position, 0..1
+    uint8_t v = a->r > a->g ? a->r : a->g;
+    v = v > a->b ? v : a->b;
+    switch (a->type) {
+        case AlienFX_A_Morph:
+            if (tau < hold) break;
+            return Mix(*a, next, (float)(tau - hold) / trans);
+        case AlienFX_A_Pulse:
+            if (tau < hold + trans / 2) break;
+            return {0, 0, 0, 255};
+        case AlienFX_A_Breathing: {
+            float tri = 1.0f - (x > 0.5f ? 2.0f * x - 1.0f : 1.0f - 2.0f * x);
+            return Mix(black, *a, tri * tri * (3.0f - 2.0f * tri));
+        }
+        case AlienFX_A_Spectrum:
+            return Hue(x, v ? v : 255);
+        case AlienFX_A_Rainbow:
+            // lights are shifted along the wheel
+            return Hue(x + block.index / 32.0f, v ? v : 255);
+    }
+    return {a->b, a->g, a->r, 255};
+}
+
+bool Afx_actionEffect::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        uint64_t bt = t;
+        if (i < starts.size())
+            bt = frame->stamp > starts[i] ? frame->stamp - starts[i] : 0;
+        frame->lights[blocks[i].index] = Eval(blocks[i], bt);
+    }
+    return true;
+}
+
+bool Afx_emulator::SetMultiAction(Afx_device* dev,
+                                  const std::vector<Afx_lightblock>& act) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto& emu = devs[dev->devID];
+    std::vector<Afx_lightblock> hw;
+    bool changed = false;
+    uint64_t now = Engine::Now();
+    for (auto& b : act) {
+        if (b.act.empty()) continue;
+        if (b.act.front().type == AlienFX_A_Power ||
+            HasHardwareActions(dev->version, b.act)) {
+            hw.push_back(b);
+            changed |= emu.lights.erase(b.index) > 0;
+        } else {
+            emu.lights[b.index] = {b, now};
+            changed = true;
+        }
+    }
+    // Replace effect before hardware update, so lights moved to hardware
+    // are not rendered over it
+    if (changed) {
+        if (emu.effectID) engine->RemoveEffect(emu.effectID);
+        emu.effectID = 0;
+        if (emu.lights.size()) {
+            std::vector<Afx_lightblock> blocks;
+            std::vector<uint64_t> starts;
+            for (auto& [lid, l] : emu.lights) {
+                blocks.push_back(l.first);
+                starts.push_back(l.second);
+            }
+            emu.effectID = engine->AddEffect(
+                dev->devID, std::make_shared<Afx_actionEffect>(blocks, starts));
+        }
+    }
+    if (hw.empty()) return true;
+    return engine->Run(dev->devID, [hw](Functions* f) mutable {
+        f->SetMultiAction(&hw);
+        f->UpdateColors();
+    });
+}
+
+void Afx_emulator::Clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& [devID, emu] : devs)
+        if (emu.effectID) engine->RemoveEffect(emu.effectID);
+    devs.clear();
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,141 @@
+#include "alienfx_spatial.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace AlienFX_SDK {
+
+// Cell arrays are padded to this size, so evaluation loops have no tail and
+// can be vectorized by compiler
+#define AFX_SPATIAL_PAD 8
+
+bool Afx_gridEffect::UpdateLayout() {
+    Afx_grid* grid = map->GetGridByID(gridID);
+    if (!grid || !grid->grid) return false;
+    // grid arrays can be freed and allocated at same address by reload
+    if (map->layoutGen == gen && grid->x == gx && grid->y == gy) return true;
+    gen = map->layoutGen;
+    const Afx_groupLight* layout = grid->grid;
+    gx = grid->x;
+    gy = grid->y;
+    cells.clear();
+    cx.clear();
+    cy.clear();
+    for (unsigned y = 0; y < gy; y++)
+        for (unsigned x = 0; x < gx; x++)
+            if (layout[y * gx + x].lgh) {
+                cells.push_back(layout[y * gx + x]);
+                cx.push_back((float)x);
+                cy.push_back((float)y);
+            }
+    size_t n = (cells.size() + AFX_SPATIAL_PAD - 1) & ~(AFX_SPATIAL_PAD - 1);
+    cx.resize(n);
+    cy.resize(n);
+    u.resize(n);
+    f.resize(n);
+    out.resize(n);
+
+    float rad = params.angle * (float)M_PI / 180.0f,
+          dx = std::cos(rad), dy = std::sin(rad);
+    bool radial = params.type == AFX_SPATIAL_RADIAL ||
+                  params.type == AFX_SPATIAL_RIPPLE;
+    float umin = 0;
+    span = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        float px = cx[i] - params.x, py = cy[i] - params.y;
+        u[i] = radial ? std::sqrt(px * px + py * py) : px * dx + py * dy;
+        span = std::max(span, u[i]);
+        umin = std::min(umin, u[i]);
+    }
+    // waves only need relative phase, keep it positive
+    if (params.type == AFX_SPATIAL_WAVE) {
+        for (size_t i = 0; i < cells.size(); i++) u[i] -= umin;
+        span -= umin;
+    }
+    len = params.length > 0 ? params.length : span > 0 ? span : 1;
+    evalStamp = 0;
+    return true;
+}
+
+void Afx_gridEffect::Evaluate(uint64_t t) {
+    const size_t n = f.size();
+    const float sec = t / 1000000.0f, inv = 1.0f / len;
+    float* __restrict fv = f.data();
+    const float* __restrict uv = u.data();
+    switch (params.type) {
+        case AFX_SPATIAL_LINEAR:
+        case AFX_SPATIAL_RADIAL:
+            for (size_t i = 0; i < n; i++)
+                fv[i] = std::min(1.0f, std::max(0.0f, uv[i] * inv));
+            break;
+        case AFX_SPATIAL_WAVE: {
+            float ph = params.speed * sec;
+            ph = 1.0f - (ph - std::floor(ph));
+            // smoothed triangle, crest at phase 0
+            for (size_t i = 0; i < n; i++) {
+                float p = uv[i] * inv + ph, x = p - (float)(int32_t)p,
+                      tri = std::fabs(2.0f * x - 1.0f);
+                fv[i] = tri * tri * (3.0f - 2.0f * tri);
+            }
+        } break;
+        case AFX_SPATIAL_RIPPLE: {
+            float r = params.speed * sec, w = 2.0f / params.width, l = len,
+                  kmax = params.rings ? (float)params.rings : 1e30f;
+            for (size_t i = 0; i < n; i++) {
+                // nearest ring behind the front, ring 0 is at the front
+                float d = r - uv[i],
+                      k = (float)(int32_t)(d * inv + 1024.5f) - 1024.0f,
+                      v = std::max(0.0f, 1.0f - std::fabs(d - k * l) * w);
+                fv[i] = k >= 0.0f && k < kmax ? v : 0.0f;
+            }
+            finished = params.rings &&
+                       r - (params.rings - 1) * len - params.width / 2 > span;
+        } break;
+        case AFX_SPATIAL_BITMAP: {
+            float s = params.speed * sec,
+                  rad = params.angle * (float)M_PI / 180.0f,
+                  ox = std::cos(rad) * s + params.x,
+                  oy = std::sin(rad) * s + params.y;
+            int bw = params.bw, bh = params.bh;
+            if (!bw || !bh || params.bitmap.size() < (size_t)bw * bh) {
+                std::fill(out.begin(), out.end(), Afx_colorcode{0, 0, 0, 255});
+                return;
+            }
+            for (size_t i = 0; i < cells.size(); i++) {
+                int bx = (int)std::floor(cx[i] - ox) % bw,
+                    by = (int)std::floor(cy[i] - oy) % bh;
+                out[i] = params.bitmap[(by < 0 ? by + bh : by) * bw +
+                                       (bx < 0 ? bx + bw : bx)];
+                out[i].br = 255;
+            }
+            return;
+        }
+    }
+    // blend colors, br is always full coverage
+    const float fr = params.from.r, fg = params.from.g, fb = params.from.b,
+                dr = params.to.r - fr, dg = params.to.g - fg,
+                db = params.to.b - fb;
+    uint32_t* __restrict ov = (uint32_t*)out.data();
+    for (size_t i = 0; i < n; i++) {
+        float x = fv[i];
+        ov[i] = (uint32_t)(fb + db * x + 0.5f) |
+                (uint32_t)(fg + dg * x + 0.5f) << 8 |
+                (uint32_t)(fr + dr * x + 0.5f) << 16 | 0xff000000u;
+    }
+}
+
+bool Afx_gridEffect::Render(Afx_device* dev, Afx_frame* frame, uint64_t t) {
+    // grid can be replaced by mappings reload, engine holds mapLock here
+    if (!UpdateLayout()) return true;
+    // all devices at the grid share one evaluation per frame
+    if (!evalStamp || frame->stamp != evalStamp) {
+        Evaluate(t);
+        evalStamp = frame->stamp;
+    }
+    for (size_t i = 0; i < cells.size(); i++)
+        if (cells[i].did == dev->pid && cells[i].lid < AFX_FRAME_LIGHTS)
+            frame->lights[cells[i].lid] = out[i];
+    return !finished;
+}
+
+}  // namespace AlienFX_SDK
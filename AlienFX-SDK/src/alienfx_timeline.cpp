@@ -0,0 +1,233 @@
+#include "alienfx_timeline.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <loguru.hpp>
+
+namespace AlienFX_SDK {
+
+// Easing curves as 0..255 tables, indexed by phase position (0..255)
+struct Afx_easeTables {
+    uint8_t lut[AFX_EASE_COUNT][256];
+    Afx_easeTables() {
+        for (unsigned i = 0; i < 256; i++) {
+            float x = i / 255.0f;
+            lut[AFX_EASE_LINEAR][i] = i;
+            lut[AFX_EASE_STEP][i] = 0;
+            lut[AFX_EASE_IN][i] = (uint8_t)(x * x * 255 + 0.5f);
+            lut[AFX_EASE_OUT][i] = (uint8_t)((1 - (1 - x) * (1 - x)) * 255 +
+                                             0.5f);
+            lut[AFX_EASE_IN_OUT][i] =
+                (uint8_t)(x * x * (3 - 2 * x) * 255 + 0.5f);
+        }
+    }
+};
+static const Afx_easeTables ease;
+
+void Afx_timeline::AddKey(uint8_t kind, uint32_t target, uint32_t time,
+                          Afx_colorcode color, uint8_t easing) {
+    auto tr = std::find_if(tracks.begin(), tracks.end(), [&](auto& t) {
+        return t.kind == kind && t.target == target;
+    });
+    if (tr == tracks.end()) {
+        tracks.push_back({kind, target, {}});
+        tr = tracks.end() - 1;
+    }
+    tr->keys.push_back({time, color.r, color.g, color.b, easing});
+}
+
+bool Afx_timeline::Save(const char* path) {
+    Afx_timelineHeader hdr;
+    hdr.tracks = tracks.size();
+    hdr.duration = duration;
+    std::vector<Afx_trackEntry> entries(tracks.size());
+    uint64_t offset =
+        sizeof(hdr) + sizeof(Afx_trackEntry) * (uint64_t)tracks.size();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto& keys = tracks[i].keys;
+        std::stable_sort(keys.begin(), keys.end(),
+                         [](auto& a, auto& b) { return a.time < b.time; });
+        if (keys.size() && keys.back().time > hdr.duration && !duration)
+            hdr.duration = keys.back().time;
+        entries[i] = {tracks[i].kind, {}, tracks[i].target,
+                      (uint32_t)keys.size(), 0, offset};
+        offset += keys.size() * sizeof(Afx_keyframe);
+    }
+    // Write temp then rename, so playing file mapping is not changed
+    const std::string tmp = std::string(path) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            LOG_S(ERROR) << "Failed to open timeline for writing: " << tmp;
+            return false;
+        }
+        out.write((const char*)&hdr, sizeof(hdr));
+        out.write((const char*)entries.data(),
+                  entries.size() * sizeof(Afx_trackEntry));
+        for (auto& tr : tracks)
+            out.write((const char*)tr.keys.data(),
+                      tr.keys.size() * sizeof(Afx_keyframe));
+        if (!out.good()) {
+            LOG_S(ERROR) << "Failed to write timeline: " << tmp;
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), path)) {
+        LOG_S(ERROR) << "Failed to move timeline into place: "
+                     << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+Afx_timelinePlayer::~Afx_timelinePlayer() { Close(); }
+
+bool Afx_timelinePlayer::Open(const char* path) {
+    Close();
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_S(ERROR) << "Failed to open timeline " << path << ": "
+                     << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(Afx_timelineHeader)) {
+        size = st.st_size;
+        void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mem == MAP_FAILED ? nullptr : (uint8_t*)mem;
+    }
+    close(fd);
+    if (!data) {
+        LOG_S(ERROR) << "Failed to map timeline " << path;
+        return false;
+    }
+    // check layout only, keyframes are not touched until played
+    header = (const Afx_timelineHeader*)data;
+    entries = (const Afx_trackEntry*)(data + sizeof(Afx_timelineHeader));
+    bool valid = header->magic == AFX_TIMELINE_MAGIC &&
+                 header->version == AFX_TIMELINE_VERSION &&
+                 sizeof(Afx_timelineHeader) +
+                         header->tracks * (uint64_t)sizeof(Afx_trackEntry) <=
+                     size;
+    for (uint32_t i = 0; valid && i < header->tracks; i++) {
+        const Afx_trackEntry& e = entries[i];
+        valid = e.kind <= AFX_TRACK_GROUP && !(e.offset % 4) &&
+                e.offset <= size &&
+                e.keys <= (size - e.offset) / sizeof(Afx_keyframe);
+    }
+    if (!valid) {
+        LOG_S(ERROR) << "Invalid timeline file " << path;
+        Close();
+        return false;
+    }
+    cursors.assign(header->tracks, 0);
+    std::lock_guard<std::mutex> guard(lock);
+    seekPos = 0;
+#ifdef DEBUG
+    LOG_S(INFO) << "Timeline " << path << ": " << header->tracks
+                << " tracks, " << header->duration << " ms";
+#endif
+    return true;
+}
+
+void Afx_timelinePlayer::Close() {
+    if (data) munmap(data, size);
+    data = nullptr;
+    header = nullptr;
+    entries = nullptr;
+    size = 0;
+    cursors.clear();
+}
+
+void Afx_timelinePlayer::Seek(uint32_t pos) {
+    std::lock_guard<std::mutex> guard(lock);
+    seekPos = pos;
+}
+
+bool Afx_timelinePlayer::Eval(unsigned track, uint32_t pos,
+                              Afx_colorcode& color) {
+    const Afx_keyframe* k = Keys(track);
+    const uint32_t n = entries[track].keys;
+    if (!n || pos < k[0].time) return false;
+    uint32_t c = cursors[track];
+    if (c < n && k[c].time <= pos) {
+        // playback moves cursor a few keyframes at most
+        for (unsigned step = 0; step < 3 && c + 1 < n && k[c + 1].time <= pos;
+             step++)
+            c++;
+        if (c + 1 < n && k[c + 1].time <= pos) c = n;
+    } else
+        c = n;
+    // seek or jump, binary search for last keyframe before position
+    if (c == n)
+        c = std::upper_bound(k, k + n, pos,
+                             [](uint32_t p, const Afx_keyframe& key) {
+                                 return p < key.time;
+                             }) -
+            k - 1;
+    cursors[track] = c;
+    const Afx_keyframe& a = k[c];
+    if (c + 1 == n || a.easing == AFX_EASE_STEP) {
+        color = {a.b, a.g, a.r, 255};
+        return true;
+    }
+    const Afx_keyframe& b = k[c + 1];
+    const uint8_t e = a.easing < AFX_EASE_COUNT ? a.easing : AFX_EASE_LINEAR;
+    const int f =
+        ease.lut[e][(uint64_t)(pos - a.time) * 255 / (b.time - a.time)];
+    color = {(uint8_t)(a.b + (b.b - a.b) * f / 255),
+             (uint8_t)(a.g + (b.g - a.g) * f / 255),
+             (uint8_t)(a.r + (b.r - a.r) * f / 255), 255};
+    return true;
+}
+
+bool Afx_timelinePlayer::Render(Afx_device* dev, Afx_frame* frame,
+                                uint64_t t) {
+    if (!header) return false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (seekPos >= 0) {
+            anchor = (int64_t)t - seekPos * 1000;
+            seekPos = -1;
+        }
+    }
+    int64_t pos = ((int64_t)t - anchor) / 1000;
+    const uint32_t dur = header->duration;
+    bool done = false;
+    if (pos < 0) pos = 0;
+    if (pos > dur) {
+        if (loop && dur)
+            pos %= dur;
+        else {
+            pos = dur;
+            done = true;
+        }
+    }
+    for (uint32_t i = 0; i < header->tracks; i++) {
+        const Afx_trackEntry& e = entries[i];
+        Afx_colorcode color;
+        if (e.kind == AFX_TRACK_LIGHT) {
+            Afx_groupLight l;
+            l.lgh = e.target;
+            if (l.did != dev->pid || l.lid >= AFX_FRAME_LIGHTS) continue;
+            if (Eval(i, pos, color)) frame->lights[l.lid] = color;
+            continue;
+        }
+        // engine holds mappings lock while rendering
+        Afx_group* grp = map->GetGroupById(e.target);
+        if (!grp || !Eval(i, pos, color)) continue;
+        for (auto& l : grp->lights)
+            if (l.did == dev->pid && l.lid < AFX_FRAME_LIGHTS)
+                frame->lights[l.lid] = color;
+    }
+    return !done;
+}
+
+}  // namespace AlienFX_SDK
@@ -0,0 +1,98 @@
+// Audio visualizer benchmark: FFT throughput and latency from audio capture
+// to device report. Plays WAV or raw PCM file given, or generated tone sweep
+// over a 22x6 keyboard grid.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "alienfx_audio.h"
+
+using namespace AlienFX_SDK;
+
+// 16-bit stereo WAV with sine sweep 50 Hz - 12 kHz
+static bool WriteSweep(const char* path, unsigned rate, unsigned seconds) {
+    std::vector<int16_t> pcm(rate * seconds * 2);
+    double phase = 0;
+    for (size_t i = 0; i < pcm.size() / 2; i++) {
+        double f = 50 * std::pow(240.0, (double)i / (pcm.size() / 2));
+        phase += 2 * M_PI * f / rate;
+        pcm[2 * i] = pcm[2 * i + 1] = (int16_t)(16000 * std::sin(phase));
+    }
+    uint32_t data = pcm.size() * 2, riffSize = 36 + data, fmtSize = 16,
+             byteRate = rate * 4;
+    uint16_t format = 1, ch = 2, align = 4, sbits = 16;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, "RIFF", 4) == 4 && write(fd, &riffSize, 4) == 4 &&
+              write(fd, "WAVEfmt ", 8) == 8 && write(fd, &fmtSize, 4) == 4 &&
+              write(fd, &format, 2) == 2 && write(fd, &ch, 2) == 2 &&
+              write(fd, &rate, 4) == 4 && write(fd, &byteRate, 4) == 4 &&
+              write(fd, &align, 2) == 2 && write(fd, &sbits, 2) == 2 &&
+              write(fd, "data", 4) == 4 && write(fd, &data, 4) == 4 &&
+              write(fd, pcm.data(), data) == (ssize_t)data;
+    close(fd);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const unsigned gx = 22, gy = 6, seconds = 5;
+    const char* path = argc > 1 ? argv[1] : "/tmp/afx_sweep.wav";
+    if (argc < 2 && !WriteSweep(path, 48000, seconds)) return 1;
+
+    Mappings map;
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    for (unsigned lid = 0; lid < gx * gy; lid++)
+        dev->lights.push_back({(uint8_t)lid, {0}, 0});
+    Afx_grid grid{1, gx, gy, 0, new Afx_groupLight[gx * gy]};
+    for (unsigned i = 0; i < gx * gy; i++)
+        grid.grid[i] = {{dev->pid, (unsigned short)i}};
+    map.GetGrids()->push_back(grid);
+    dev->dev = new Functions();
+    dev->present = true;
+
+    Afx_audioParams params;
+    params.gridID = 1;
+
+    // offline FFT throughput
+    {
+        Afx_audio audio(&map, params);
+        std::vector<int16_t> pcm(48000 * 2);
+        for (size_t i = 0; i < pcm.size(); i++)
+            pcm[i] = (int16_t)(8000 * std::sin(i * 0.05));
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < 20; r++)
+            audio.Push(pcm.data(), pcm.size() / 2, Engine::Now());
+        double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        Afx_audioStats st = audio.GetStats();
+        std::cout << st.blocks << " windows of " << params.fftSize
+                  << " samples in " << sec * 1000 << " ms, "
+                  << st.fftTime << " us per window\n";
+    }
+
+    // real time playback through engine
+    Engine engine(&map, 60);
+    auto audio = std::make_shared<Afx_audio>(&map, params);
+    engine.AddEffect(dev->devID, audio);
+    engine.Start();
+    if (!audio->Open(path)) return 1;
+    Afx_engineStats est;
+    for (unsigned s = 0; s < seconds; s++) {
+        sleep(1);
+        est = engine.GetStats(dev->devID);
+        std::cout << "fps " << est.fps << ", audio to report latency avg "
+                  << est.srcLatAvg << " ms, max " << est.srcLatMax << " ms\n";
+    }
+    Afx_audioStats st = audio->GetStats();
+    std::cout << st.blocks << " spectrums, " << st.overruns
+              << " not rendered, " << est.reports << " reports\n";
+    audio->Close();
+    engine.Stop();
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Color pipeline benchmark: white balance, brightness, gamma and quantization
+// over 1k and 10k light arrays for every supported SIMD level.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "alienfx_color.h"
+
+using namespace AlienFX_SDK;
+
+static const char* levelNames[]{"scalar", "sse2", "avx2"};
+
+static std::vector<Afx_colorcode> MakeColors(size_t lights) {
+    std::vector<Afx_colorcode> colors(lights);
+    for (size_t i = 0; i < lights; i++) colors[i].ci = rand();
+    return colors;
+}
+
+static void Run(size_t lights, unsigned rounds, float gamma, int version) {
+    std::vector<Afx_colorcode> src = MakeColors(lights), ref, work;
+    Afx_colorPipe pipe;
+    int best = pipe.simd;
+    pipe.Setup({200, 220, 255}, 180, version, gamma);
+    for (int level = AFX_SIMD_NONE; level <= best; level++) {
+        pipe.simd = level;
+        work = src;
+        pipe.Apply(work.data(), work.size());
+        if (level == AFX_SIMD_NONE) ref = work;
+        bool match = ref.size() == work.size();
+        for (size_t i = 0; match && i < work.size(); i++)
+            match = ref[i].ci == work[i].ci;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned r = 0; r < rounds; r++) {
+            work = src;
+            pipe.Apply(work.data(), work.size());
+        }
+        double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        std::cout << lights << " lights, gamma " << gamma << ", v" << version
+                  << ", " << levelNames[level] << ": "
+                  << (unsigned)(lights * rounds / sec / 1000000)
+                  << " Mlights/s, " << sec * 1000000 / rounds << " us/frame"
+                  << (match ? "" : " MISMATCH") << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    std::cout << "Best SIMD level: " << levelNames[Afx_colorPipe::Detect()]
+              << "\n";
+    for (size_t lights : {1000, 10000}) {
+        Run(lights, rounds, 1.0f, API_V5);
+        Run(lights, rounds, 2.2f, API_V5);
+        // 4-bit quantization
+        Run(lights, rounds, 1.0f, API_V2);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Frame building benchmark: memory and throughput of building 1000-light
+// frames with compact light blocks vs. the old vector-based layout.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "AlienFX_SDK.h"
+
+using namespace AlienFX_SDK;
+
+static size_t allocCount = 0, allocBytes = 0;
+
+void* operator new(size_t size) {
+    allocCount++;
+    allocBytes += size;
+    if (void* p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Light block layout before compact actions
+struct LegacyLightblock {
+    uint8_t index;
+    std::vector<Afx_action> act;
+};
+
+template <class Block>
+static void Run(const char* name, unsigned lights, unsigned frames,
+                unsigned phases) {
+    std::vector<Block> frame;
+    size_t checksum = 0;
+    allocCount = allocBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < frames; f++) {
+        frame.clear();
+        frame.reserve(lights);
+        for (unsigned l = 0; l < lights; l++) {
+            Block b{(uint8_t)l, {}};
+            for (unsigned p = 0; p < phases; p++)
+                b.act.push_back({AlienFX_A_Color, 0, 0, (uint8_t)(f + p),
+                                 (uint8_t)l, (uint8_t)p});
+            frame.push_back(std::move(b));
+        }
+        checksum += frame.back().act.front().r;
+    }
+    double sec = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    std::cout << name << ", " << phases << " phase(s): block "
+              << sizeof(Block) << " bytes, " << (double)allocCount / frames
+              << " allocs/frame, " << allocBytes / frames
+              << " heap bytes/frame, " << (unsigned)(frames / sec)
+              << " frames/s (" << checksum % 10 << ")\n";
+}
+
+int main(int argc, char** argv) {
+    unsigned lights = 1000, frames = argc > 1 ? atoi(argv[1]) : 2000;
+    std::cout << "Building " << frames << " frames of " << lights
+              << " lights\n";
+    std::cout << "Afx_colorcode " << sizeof(Afx_colorcode)
+              << " bytes, Afx_groupLight " << sizeof(Afx_groupLight)
+              << " bytes, Afx_light " << sizeof(Afx_light) << " bytes\n";
+    // 4 phases exceed inline storage
+    for (unsigned phases : {1, 3, 4}) {
+        Run<LegacyLightblock>("legacy vector", lights, frames, phases);
+        Run<Afx_lightblock>("inline actions", lights, frames, phases);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Image stream benchmark: downscale throughput for 1080p RGB images to a
+// 22x6 keyboard grid for every SIMD level, then 60 fps playback of moving
+// images through the engine with image to report latency.
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "alienfx_image.h"
+
+using namespace AlienFX_SDK;
+
+static const char* simdNames[]{"scalar", "sse2", "avx2"};
+
+int main(int argc, char** argv) {
+    unsigned images = argc > 1 ? atoi(argv[1]) : 600;
+    const unsigned gx = 22, gy = 6, w = 1920, h = 1080, fps = 60;
+    Mappings map;
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    for (unsigned lid = 0; lid < gx * gy; lid++)
+        dev->lights.push_back({(uint8_t)lid, {0}, 0});
+    Afx_grid grid{1, gx, gy, 0, new Afx_groupLight[gx * gy]};
+    for (unsigned i = 0; i < gx * gy; i++)
+        grid.grid[i] = {{dev->pid, (unsigned short)i}};
+    map.GetGrids()->push_back(grid);
+    dev->dev = new Functions();
+    dev->present = true;
+
+    // few images with gradient moving by frame
+    std::vector<std::vector<uint8_t>> frames(8);
+    for (unsigned f = 0; f < frames.size(); f++) {
+        frames[f].resize(w * h * 3);
+        for (unsigned y = 0; y < h; y++)
+            for (unsigned x = 0; x < w; x++) {
+                uint8_t* p = &frames[f][(y * w + x) * 3];
+                p[0] = (x + f * 64) & 0xff;
+                p[1] = y & 0xff;
+                p[2] = (x ^ y) & 0xff;
+            }
+    }
+
+    for (int level = AFX_SIMD_NONE; level <= Afx_colorPipe::Detect();
+         level++) {
+        Afx_imageStream stream(&map, 1);
+        stream.simd = level;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < images; i++)
+            stream.Push(frames[i % frames.size()].data(), w, h, w * 3,
+                        Engine::Now());
+        double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        std::cout << simdNames[level] << ": " << images / sec
+                  << " images/s, " << sec * 1000000 / images
+                  << " us per 1080p image\n";
+    }
+
+    // paced playback through engine
+    Engine engine(&map, fps);
+    auto stream = std::make_shared<Afx_imageStream>(&map, 1);
+    engine.AddEffect(dev->devID, stream);
+    engine.Start();
+    uint64_t start = Engine::Now();
+    for (unsigned i = 0; i < fps * 3; i++) {
+        uint64_t due = start + i * 1000000ull / fps, now = Engine::Now();
+        if (due > now) usleep(due - now);
+        stream->Push(frames[i % frames.size()].data(), w, h, w * 3,
+                     Engine::Now());
+    }
+    Afx_engineStats est = engine.GetStats(dev->devID);
+    Afx_imageStats st = stream->GetStats();
+    std::cout << st.frames << " images, " << st.dropped << " not rendered, "
+              << st.scaleTime << " us scale, engine fps " << est.fps
+              << ", image to report latency avg " << est.srcLatAvg
+              << " ms, max " << est.srcLatMax << " ms\n";
+    engine.Stop();
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Keypress reaction benchmark: latency from key event to queued frame.
+// Synthetic key presses are written to a pipe, or recorded event stream
+// (raw input_event records, e.g. from /dev/input/eventN) is replayed.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "alienfx_input.h"
+
+using namespace AlienFX_SDK;
+
+int main(int argc, char** argv) {
+    unsigned presses = 500;
+    Mappings map;
+    // virtual keyboard with one light per key code
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    for (unsigned lid = 0; lid < 128; lid++)
+        dev->lights.push_back({(uint8_t)lid, {{0, (unsigned short)lid}}, 0});
+    dev->dev = new Functions();
+    dev->present = true;
+
+    Engine engine(&map, 30);
+    Afx_input input(&map, &engine);
+    auto effect =
+        std::make_shared<Afx_reactiveEffect>(&map, Afx_reactParams{});
+    engine.AddEffect(dev->devID, effect);
+    input.AddEffect(effect);
+    engine.Start();
+
+    if (argc > 1) {
+        input.Replay(argv[1]);
+    } else {
+        int pfd[2];
+        if (pipe(pfd)) return 1;
+        input.AddFd(pfd[0]);
+        for (unsigned i = 0; i < presses; i++) {
+            uint64_t now = Engine::Now();
+            input_event ev[2]{};
+            for (auto& e : ev) {
+                e.input_event_sec = now / 1000000;
+                e.input_event_usec = now % 1000000;
+            }
+            ev[0].type = EV_KEY;
+            ev[0].code = KEY_A + i % 26;
+            ev[0].value = 1;
+            ev[1].type = EV_SYN;
+            if (write(pfd[1], ev, sizeof(ev)) != sizeof(ev)) break;
+            usleep(2000);
+        }
+        usleep(10000);
+        close(pfd[1]);
+    }
+    Afx_inputStats st = input.GetStats();
+    std::cout << st.presses << " presses, " << st.mapped
+              << " with lights, latency avg " << st.latAvg << " ms, max "
+              << st.latMax << " ms\n";
+    input.Stop();
+    engine.Stop();
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Compositor benchmark: 8 layers over a 132-light keyboard, one layer
+// changing a few lights per frame (notification over game and ambient
+// layers), against every layer changing all lights. Also checks blend
+// results for a masked layer.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "alienfx_layers.h"
+
+using namespace AlienFX_SDK;
+
+static double Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv) {
+    const unsigned lights = 132, layerCount = 8,
+                   frames = argc > 1 ? atoi(argv[1]) : 20000;
+    Mappings map;
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    Afx_compositor comp(&map);
+    unsigned ids[layerCount];
+    for (unsigned l = 0; l < layerCount; l++) {
+        ids[l] = comp.AddLayer(l, l % AFX_BLEND_COUNT);
+        for (unsigned i = 0; i < lights; i++)
+            comp.SetLight(ids[l], dev->devID, i,
+                          {(uint8_t)(i * l), (uint8_t)l, 128, 200});
+    }
+    Afx_frame frame;
+    frame.Clear();
+    comp.Render(dev, &frame, 0);
+
+    auto run = [&](const char* name, unsigned changed) {
+        Afx_compositorStats before = comp.GetStats();
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned f = 0; f < frames; f++) {
+            for (unsigned l = 0; l < (changed < lights ? 1 : layerCount); l++)
+                for (unsigned i = 0; i < changed; i++)
+                    comp.SetLight(ids[l], dev->devID, (f + i) % lights,
+                                  {(uint8_t)f, (uint8_t)i, 0, 255});
+            frame.Clear();
+            comp.Render(dev, &frame, 0);
+        }
+        double total = Since(start);
+        Afx_compositorStats st = comp.GetStats();
+        std::cout << name << ": " << total / frames << " us per frame, "
+                  << (st.recomputed - before.recomputed) / (double)frames
+                  << " lights composed per frame\n";
+    };
+    run("4 lights of one layer", 4);
+    run("all lights of all layers", lights);
+
+    // red base, green masked to light 1 at half opacity, additive blue
+    Afx_compositor check(&map);
+    unsigned base = check.AddLayer(0), top = check.AddLayer(5),
+             add = check.AddLayer(9, AFX_BLEND_ADD);
+    for (uint8_t i = 0; i < 3; i++) {
+        check.SetLight(base, dev->devID, i, {0, 0, 255, 255});
+        check.SetLight(top, dev->devID, i, {0, 255, 0, 128});
+    }
+    check.SetLight(add, dev->devID, 2, {255, 0, 0, 255});
+    check.SetMask(top, {{{dev->pid, 1}}});
+    frame.Clear();
+    check.Render(dev, &frame, 0);
+    bool ok = frame.lights[0].ci == Afx_colorcode{0, 0, 255, 255}.ci &&
+              frame.lights[1].ci == Afx_colorcode{0, 128, 127, 255}.ci &&
+              frame.lights[2].ci == Afx_colorcode{255, 0, 255, 255}.ci;
+    check.RemoveLayer(base);
+    frame.Clear();
+    check.Render(dev, &frame, 0);
+    ok = ok && !frame.lights[0].r && frame.lights[0].br;
+    std::cout << "blend check " << (ok ? "passed" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
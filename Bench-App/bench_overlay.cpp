@@ -0,0 +1,66 @@
+// Overlay benchmark: every present light device runs a full-frame effect
+// (all lights change every frame, bulk USB traffic) while notification
+// overlays flash its first lights. Reports Flash call to first report
+// latency against regular frame latency.
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "alienfx_engine.h"
+
+using namespace AlienFX_SDK;
+
+class Afx_sweep : public Afx_effect {  // every light changes every frame
+   public:
+    bool Render(Afx_device* dev, Afx_frame* frame, uint64_t t) override {
+        uint8_t v = (uint8_t)(t / 10000);
+        for (auto& l : dev->lights) frame->Set(l.lightid, v, 255 - v, v / 2);
+        return true;
+    }
+};
+
+int main(int argc, char** argv) {
+    unsigned flashes = argc > 1 ? atoi(argv[1]) : 20;
+    Mappings map;
+    map.LoadMappings();
+    map.AlienFXEnumDevices();
+    Engine engine(&map, 30);
+    Afx_flash flash;
+    flash.color = {255, 255, 255, 255};
+    flash.on = 100;
+    flash.off = 150;
+    flash.count = 1;
+    for (auto& dev : map.fxdevs) {
+        if (!dev.dev || !dev.present || dev.dev->version == API_ACPI)
+            continue;
+        engine.AddEffect(dev.devID, std::make_shared<Afx_sweep>());
+        for (unsigned i = 0; i < dev.lights.size() && i < 4; i++)
+            flash.lights.push_back({{dev.pid, dev.lights[i].lightid}});
+    }
+    if (flash.lights.empty()) {
+        std::cout << "No light devices found\n";
+        return 0;
+    }
+    engine.Start();
+    usleep(500000);
+    for (unsigned f = 0; f < flashes; f++) {
+        engine.Flash(flash);
+        // random phase against frame ticks
+        usleep(300000 + rand() % 33000);
+    }
+    usleep(200000);
+    for (auto& dev : map.fxdevs) {
+        Afx_engineStats st = engine.GetStats(dev.devID);
+        if (!st.frames) continue;
+        std::cout << "Device 0x" << std::hex << dev.devID << std::dec << ": "
+                  << st.frames << " frames, frame latency " << st.latAvg
+                  << " ms avg, " << st.latMax << " ms max; " << st.overlays
+                  << " overlays, call to first report "
+                  << st.overlayLatAvg << " ms avg, " << st.overlayLatMax
+                  << " ms max\n";
+    }
+    engine.Stop();
+    return 0;
+}
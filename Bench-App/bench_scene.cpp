@@ -0,0 +1,75 @@
+// Scene cache benchmark: profile switch time with encoding on every switch
+// vs. replay of cached reports, for every present light device. Two scenes
+// (all lights red, all lights blue) are switched back and forth.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "alienfx_scene.h"
+
+using namespace AlienFX_SDK;
+
+static double Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv) {
+    unsigned switches = argc > 1 ? atoi(argv[1]) : 20;
+    Mappings map;
+    map.LoadMappings();
+    map.AlienFXEnumDevices();
+    Afx_sceneCache cache;
+    unsigned found = 0;
+    for (auto& dev : map.fxdevs) {
+        if (!dev.dev || !dev.present || dev.dev->version == API_ACPI)
+            continue;
+        found++;
+        std::vector<Afx_lightblock> scenes[2];
+        for (auto& l : dev.lights) {
+            if (l.flags & ALIENFX_FLAG_POWER) continue;
+            scenes[0].push_back(
+                {l.lightid, {{AlienFX_A_Color, 0, 0, 255, 0, 0}}});
+            scenes[1].push_back(
+                {l.lightid, {{AlienFX_A_Color, 0, 0, 0, 0, 255}}});
+        }
+        // encode on every switch
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned s = 0; s < switches; s++) {
+            auto act = scenes[s & 1];
+            dev.dev->SetMultiAction(&act);
+            dev.dev->UpdateColors();
+        }
+        double direct = Since(start) / switches;
+        // encoding only
+        start = std::chrono::steady_clock::now();
+        size_t reports = 0;
+        for (unsigned s = 0; s < switches; s++)
+            reports = dev.dev
+                          ->DryRun([&](Functions* f) {
+                              auto act = scenes[s & 1];
+                              f->SetMultiAction(&act);
+                              f->UpdateColors();
+                          })
+                          .size();
+        double encode = Since(start) / switches;
+        // cached
+        cache.Find("red", &dev, scenes[0]);
+        cache.Find("blue", &dev, scenes[1]);
+        start = std::chrono::steady_clock::now();
+        for (unsigned s = 0; s < switches; s++)
+            cache.Apply(s & 1 ? "blue" : "red", &dev, scenes[s & 1]);
+        double cached = Since(start) / switches;
+        std::cout << "Device " << std::hex << dev.vid << ":" << dev.pid
+                  << std::dec << " (API v" << dev.dev->version << ", "
+                  << scenes[0].size() << " lights, " << reports
+                  << " reports): direct " << direct << " ms, encoding "
+                  << encode << " ms, cached " << cached << " ms per switch\n";
+    }
+    if (!found) std::cout << "No light devices found\n";
+    Afx_sceneStats st = cache.GetStats();
+    std::cout << st.compiled << " compiled, " << st.hits << " cache hits\n";
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Frame ring benchmark: attaches a shared frame ring to an in-process daemon
+// socket, then streams 132-light frames at full speed and at 60 fps. Reports
+// client cost per frame, eventfd wakeups and commit to render latency, and
+// compares client cost with sending the same frames over the socket.
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "alienfx_ipc.h"
+#include "alienfx_shm.h"
+
+using namespace AlienFX_SDK;
+
+static double Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv) {
+    const unsigned lights = 132, frames = argc > 1 ? atoi(argv[1]) : 200000;
+    const std::string path = "/tmp/afx_bench.sock";
+
+    // daemon side: render every wakeup, as alienfxd does with Engine::Tick
+    Afx_ipcServer server;
+    if (!server.Listen(path)) return 1;
+    std::shared_ptr<Afx_shmReader> ring;
+    Afx_frame frame;
+    double latSum = 0, latMax = 0;
+    unsigned latCount = 0;
+    auto render = [&]() {
+        if (!ring->Wake()) return;
+        frame.Clear();
+        frame.source = 0;
+        ring->Render(nullptr, &frame, 0);
+        if (frame.source) {
+            double lat = (Engine::Now() - frame.source) / 1000.0;
+            latSum += lat;
+            latMax = std::max(latMax, lat);
+            latCount++;
+        }
+    };
+    std::thread daemon([&]() {
+        server.Run([&](const std::vector<std::string>& args, std::string&) {
+            auto fds = server.TakeFds();
+            ring = std::make_shared<Afx_shmReader>();
+            if (fds.size() != 2 || !ring->Attach(fds[0], fds[1])) return 1;
+            server.AddWatch(ring->EventFd(), render);
+            return 0;
+        });
+    });
+
+    Afx_shmWriter writer;
+    Afx_ipcClient client;
+    std::string out;
+    int status = 1;
+    if (!writer.Create() || !client.Connect(path) ||
+        !client.Request({"attach", "0"}, out, status,
+                        {writer.MemFd(), writer.EventFd()}) ||
+        status) {
+        std::cout << "Attach failed\n";
+        server.Stop();
+        daemon.join();
+        return 1;
+    }
+
+    // full speed: most frames coalesce, wakeups only when daemon sleeps
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < frames; f++) {
+        Afx_colorcode* l = writer.Begin();
+        for (unsigned i = 0; i < lights; i++)
+            l[i] = {(uint8_t)(f + i), (uint8_t)i, (uint8_t)f, 255};
+        writer.Commit(Engine::Now());
+    }
+    double total = Since(start);
+    usleep(100000);
+    Afx_shmStats st = ring->GetStats();
+    std::cout << "ring, full speed: " << total * 1000 / frames
+              << " ns per frame, " << st.frames << " rendered, "
+              << st.skipped << " coalesced, " << st.wakeups << " wakeups, "
+              << st.retries << " retries\n";
+
+    // 60 fps: every frame wakes daemon
+    latSum = latMax = latCount = 0;
+    const unsigned paced = 300;
+    for (unsigned f = 0; f < paced; f++) {
+        Afx_colorcode* l = writer.Begin();
+        for (unsigned i = 0; i < lights; i++) l[i] = {0, 0, (uint8_t)f, 255};
+        writer.Commit(Engine::Now());
+        usleep(16667);
+    }
+    std::cout << "ring, 60 fps: commit to render " << latSum / latCount
+              << " ms avg, " << latMax << " ms max\n";
+    server.Stop();
+    daemon.join();
+
+    // same frames copied through socket, for comparison
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) return 1;
+    std::thread sink([&]() {
+        Afx_colorcode buf[AFX_FRAME_LIGHTS];
+        while (read(sv[1], buf, sizeof(buf)) > 0) {
+        }
+    });
+    Afx_colorcode l[AFX_FRAME_LIGHTS]{};
+    start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < frames; f++) {
+        for (unsigned i = 0; i < lights; i++)
+            l[i] = {(uint8_t)(f + i), (uint8_t)i, (uint8_t)f, 255};
+        if (write(sv[0], l, sizeof(l)) < 0) break;
+    }
+    total = Since(start);
+    close(sv[0]);
+    sink.join();
+    close(sv[1]);
+    std::cout << "socket, full speed: " << total * 1000 / frames
+              << " ns per frame\n";
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Spatial renderer benchmark: time to evaluate effects over a 22x6 keyboard
+// grid and scatter them into the device frame.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "alienfx_spatial.h"
+
+using namespace AlienFX_SDK;
+
+static const char* typeNames[]{"linear", "radial", "wave", "ripple",
+                               "bitmap"};
+
+int main(int argc, char** argv) {
+    unsigned frames = argc > 1 ? atoi(argv[1]) : 100000;
+    const unsigned gx = 22, gy = 6;
+    Mappings map;
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    for (unsigned lid = 0; lid < gx * gy; lid++)
+        dev->lights.push_back({(uint8_t)lid, {0}, 0});
+    Afx_grid grid{1, gx, gy, 0, new Afx_groupLight[gx * gy]};
+    for (unsigned i = 0; i < gx * gy; i++)
+        grid.grid[i] = {{dev->pid, (unsigned short)i}};
+    map.GetGrids()->push_back(grid);
+
+    Afx_spatial params;
+    params.from = {0, 0, 255};
+    params.to = {255, 0, 0};
+    params.x = 10;
+    params.y = 3;
+    params.angle = 30;
+    params.length = 6;
+    params.speed = 2;
+    params.rings = 0;
+    params.bw = params.bh = 8;
+    for (unsigned i = 0; i < 64; i++)
+        params.bitmap.push_back({(uint8_t)(i * 4), (uint8_t)i, 0, 0});
+
+    Afx_frame frame;
+    for (int type = AFX_SPATIAL_LINEAR; type <= AFX_SPATIAL_BITMAP; type++) {
+        params.type = type;
+        Afx_gridEffect effect(&map, 1, params);
+        unsigned checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned f = 0; f < frames; f++) {
+            frame.Clear();
+            frame.stamp = f + 1;
+            effect.Render(dev, &frame, f * 16667ull);
+            checksum += frame.lights[f % (gx * gy)].r;
+        }
+        double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+        std::cout << typeNames[type] << ": " << sec * 1000000 / frames
+                  << " us/frame for " << gx * gy << " cells (" << checksum % 10
+                  << ")\n";
+    }
+    return 0;
+}
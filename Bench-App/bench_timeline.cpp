@@ -0,0 +1,77 @@
+// Timeline benchmark: builds a long show for a 132-light keyboard (keyframe
+// every 100 ms per light), then measures open, frame render and seek times
+// and resident memory of the mapped file.
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "alienfx_timeline.h"
+
+using namespace AlienFX_SDK;
+
+// Resident set size, MB
+static double Resident() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, rss = 0;
+    statm >> total >> rss;
+    return rss * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+static double Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv) {
+    const unsigned lights = 132, minutes = argc > 1 ? atoi(argv[1]) : 30;
+    const char* path = "/tmp/afx_show.afxt";
+    Mappings map;
+    Afx_device* dev = map.AddDeviceById(0x187c0550);
+    {
+        Afx_timeline show;
+        for (unsigned lid = 0; lid < lights; lid++) {
+            Afx_groupLight l{{dev->pid, (unsigned short)lid}};
+            for (uint32_t t = 0; t < minutes * 60000; t += 100)
+                show.AddKey(AFX_TRACK_LIGHT, l.lgh, t,
+                            {(uint8_t)(t / 100 + lid), (uint8_t)lid, 0},
+                            (t / 100) % AFX_EASE_COUNT);
+        }
+        if (!show.Save(path)) return 1;
+    }
+    double before = Resident();
+    Afx_timelinePlayer player(&map);
+    auto start = std::chrono::steady_clock::now();
+    if (!player.Open(path)) return 1;
+    std::cout << "open " << Since(start) << " us, "
+              << player.Duration() / 1000 << " s show\n";
+
+    // 60 fps playback from start
+    Afx_frame frame;
+    const unsigned frames = 3600;
+    start = std::chrono::steady_clock::now();
+    for (unsigned f = 0; f < frames; f++) {
+        frame.Clear();
+        player.Render(dev, &frame, f * 16667ull);
+    }
+    std::cout << "play " << Since(start) / frames << " us per frame, "
+              << "resident " << Resident() - before << " MB\n";
+
+    // random seeks over whole show
+    const unsigned seeks = 10000;
+    srand(1);
+    start = std::chrono::steady_clock::now();
+    for (unsigned s = 0; s < seeks; s++) {
+        player.Seek(rand() % player.Duration());
+        frame.Clear();
+        player.Render(dev, &frame, 1000000ull * s);
+    }
+    std::cout << "seek " << Since(start) / seeks << " us per seek and frame, "
+              << "resident " << Resident() - before << " MB of "
+              << lights * (minutes * 600) * sizeof(Afx_keyframe) / (1 << 20)
+              << " MB file\n";
+    return 0;
+}
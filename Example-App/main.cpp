@@ -12,20 +12,20 @@ int main() {
     afx_map.LoadMappings();
     afx_map.AlienFXEnumDevices();
     for (auto it = afx_map.fxdevs.begin(); it != afx_map.fxdevs.end(); it++)
-        LOG_S(INFO) << "Stored device " << it->name << ", " << it->lights.size()
-                    << " lights";
+        LOG_S(INFO) << "Stored device " << afx_map.names.Get(it->nameid)
+                    << ", " << it->lights.size() << " lights";
     LOG_S(INFO) << afx_map.fxdevs.size() << " device(s) detected.";
     for (const auto& dev : afx_map.fxdevs) {
         std::cout << "Device VID:PID = " << std::hex << std::setw(4)
                   << std::setfill('0') << dev.vid << ":" << std::hex
                   << std::setw(4) << std::setfill('0') << dev.pid << std::dec
-                  << "  name='" << dev.name << "'"
+                  << "  name='" << afx_map.names.Get(dev.nameid) << "'"
                   << "  lights=" << dev.lights.size() << "\n";
 
         for (const auto& l : dev.lights) {
             std::cout << "  - lightid=" << (int)l.lightid << " flags=0x"
-                      << std::hex << l.flags << std::dec << " name='" << l.name
-                      << "'"
+                      << std::hex << l.flags << std::dec << " name='"
+                      << afx_map.names.Get(l.nameid) << "'"
                       << "\n";
         }
     }
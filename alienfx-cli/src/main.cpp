@@ -1,14 +1,27 @@
+#include <grp.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <CLI/CLI.hpp>
+#include <csignal>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <format>
+#include <fstream>
 #include <iostream>
 #include <loguru.hpp>
 #include <map>
+#include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "AlienFan-SDK.h"
+#include "alienfx_events.h"
+#include "alienfx_ipc.h"
+#include "alienfx_layers.h"
+#include "alienfx_shm.h"
 #include "const.h"
 
 using namespace std;
@@ -19,8 +32,39 @@ static AlienFan_SDK::Control fan;
 static uint8_t globalBright = 255;
 static uint8_t sleepy = 5, longer = 5;
 static int devType = -1;
+// Running inside alienfxd: devices are initialized once at start, commands
+// come from clients
+static bool inDaemon = false;
+// Daemon layers: client layer of current command (0 - none, use devices)
+static unsigned curLayer = 0;
+static std::shared_ptr<AlienFX_SDK::Afx_compositor> compositor;
+// Daemon hooks: pause engine before command uses devices, queue overlay
+static std::function<void()> onDeviceAccess;
+static std::function<unsigned(const AlienFX_SDK::Afx_flash&)> daemonFlash;
+static bool initDone = false;
+
+// Batch mode: light commands of all lines are merged per device and sent as
+// one transaction after every line parsed
+struct Afx_batch {
+    std::map<AlienFX_SDK::Afx_device*,
+             std::map<uint8_t, vector<AlienFX_SDK::Afx_action>>>
+        lights;                        // last actions set for light
+    vector<string> line;               // line being parsed
+    vector<vector<string>> deferred;   // other device commands, run after
+};
+static Afx_batch* batch = nullptr;
+// Batch line is running, global options default to batch ones
+static bool inLine = false;
+
+// Queue light actions into batch, later commands override earlier ones
+static void Queue(AlienFX_SDK::Afx_device& dev, const vector<uint8_t>& lights,
+                  const vector<AlienFX_SDK::Afx_action>& act) {
+    for (uint8_t lid : lights) batch->lights[&dev][lid] = act;
+}
 
 static void Update() {
+    // batch updates devices once, at the end
+    if (batch) return;
     for (auto& d : afx_map.fxdevs) {
         if (d.dev) d.dev->UpdateColors();
     }
@@ -45,7 +89,7 @@ static void initCli() {
 static unsigned GetZoneCodeFromString(const std::string& zone) {
     if (auto* groups = afx_map.GetGroups()) {
         for (const auto& g : *groups) {
-            if (g.name == zone) {
+            if (afx_map.names.Get(g.nameid) == zone) {
                 return static_cast<unsigned>(g.gid);
             }
         }
@@ -62,8 +106,7 @@ static uint8_t ActionFromString(const std::string& name) {
     for (const auto& a : actioncodes) {
         if (name == a.name) return static_cast<uint8_t>(a.afx_code);
     }
-    LOG_F(ERROR, "Unknown action: %s", name.c_str());
-    std::exit(1);
+    throw CLI::ValidationError("action", "Unknown action: " + name);
 }
 
 static AlienFX_SDK::Afx_action MakeColorAction(int r, int g, int b,
@@ -92,10 +135,8 @@ static vector<AlienFX_SDK::Afx_action> ParseActionList(
         acttype = ActionFromString(actName);
         i++;
 
-        if (i + 2 >= tokens.size()) {
-            LOG_F(ERROR, "Action requires r g b");
-            std::exit(1);
-        }
+        if (i + 2 >= tokens.size())
+            throw CLI::ValidationError("action", "Action requires r g b");
         int r = stoi(tokens[i++]);
         int g = stoi(tokens[i++]);
         int b = stoi(tokens[i++]);
@@ -123,7 +164,258 @@ static string ReadLineTrimmed() {
     return s;
 }
 
-int main(int argc, char** argv) {
+// Split command line into arguments, "" quote arguments with spaces
+static vector<string> SplitLine(const string& line) {
+    vector<string> args;
+    string arg;
+    bool quoted = false, inArg = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            inArg = true;
+        } else if (!quoted && std::isspace((unsigned char)c)) {
+            if (inArg) args.push_back(arg);
+            arg.clear();
+            inArg = false;
+        } else {
+            arg += c;
+            inArg = true;
+        }
+    }
+    if (inArg) args.push_back(arg);
+    return args;
+}
+
+// Forward command line to daemon, false if no daemon is running
+static bool RunAtDaemon(const vector<string>& args, int& status) {
+    AlienFX_SDK::Afx_ipcClient client;
+    string out;
+    if (!client.Connect() || !client.Request(args, out, status)) return false;
+    (status ? cerr : cout) << out << flush;
+    return true;
+}
+
+static int RunCli(int argc, char** argv);
+
+// Run batch line as command line. Line options apply to it only, batch
+// ones are restored after.
+static int RunLine(const vector<string>& args) {
+    vector<char*> argv{(char*)"alienfx-cli"};
+    for (auto& a : args) argv.push_back((char*)a.c_str());
+    argv.push_back(nullptr);
+    uint8_t bright = globalBright, tempo = sleepy, length = longer;
+    bool outer = inLine;
+    inLine = true;
+    int status = RunCli((int)args.size() + 1, argv.data());
+    inLine = outer;
+    globalBright = bright;
+    sleepy = tempo;
+    longer = length;
+    return status;
+}
+
+// Parse event subscription: device, profile, sensor[:threshold], effect or
+// all (also no types). Returns AFX_EVENT_* mask.
+static int ParseEventTypes(const vector<string>& types, int& threshold) {
+    int mask = types.empty() ? AFX_EVENT_ALL : 0;
+    for (auto& t : types) {
+        if (t == "device")
+            mask |= AFX_EVENT_DEVICE_ADDED | AFX_EVENT_DEVICE_REMOVED;
+        else if (t == "profile")
+            mask |= AFX_EVENT_PROFILE;
+        else if (t == "effect")
+            mask |= AFX_EVENT_EFFECT_DONE;
+        else if (t == "all")
+            mask |= AFX_EVENT_ALL;
+        else if (t.starts_with("sensor")) {
+            mask |= AFX_EVENT_SENSOR;
+            if (t.size() > 7 && t[6] == ':') threshold = atoi(t.c_str() + 7);
+        } else
+            throw CLI::ValidationError("types", "Unknown event type: " + t);
+    }
+    return mask;
+}
+
+// Watch all temperature sensors for events
+static vector<unsigned> WatchSensors(AlienFX_SDK::Afx_events& bus,
+                                     int threshold) {
+    vector<unsigned> ids;
+    for (auto& s : fan.sensors)
+        ids.push_back(bus.WatchSensor(
+            s.name, [s]() { return fan.GetTempValue(s); }, threshold));
+    return ids;
+}
+
+static volatile sig_atomic_t streamStop = 0;
+
+struct Afx_streamDev {  // Stream output to device
+    AlienFX_SDK::Afx_shmWriter ring;
+    std::shared_ptr<AlienFX_SDK::Afx_shmReader> reader;  // direct mode
+    AlienFX_SDK::Afx_colorcode state[AFX_FRAME_LIGHTS]{};
+    bool changed = false;
+    unsigned frames = 0;  // input frames
+};
+
+// Read frames from stdin until EOF or SIGINT and show them through frame
+// ring per device, attached to daemon layer (daemon - connection to it) or
+// to local engine. Frames read together are merged, ring keeps the latest
+// one only, so input never waits for devices. raw - binary frames of r g b
+// bytes for lights 0..raw-1 of device rawDev, 0 - text lines of
+// "dev light r g b" tuples, a line per frame.
+static void StreamFrames(AlienFX_SDK::Afx_ipcClient* daemon, unsigned raw,
+                         unsigned rawDev) {
+    std::map<unsigned, Afx_streamDev> devs;
+    AlienFX_SDK::Engine engine(&afx_map, 60);
+    std::set<unsigned> failed;  // devices which can't be opened
+    string error;                // why last device can't be opened
+    // Frame ring for device, nullptr if it can't be used
+    auto open = [&](unsigned d) -> Afx_streamDev* {
+        auto it = devs.find(d);
+        if (it != devs.end()) return &it->second;
+        if (failed.count(d)) return nullptr;
+        error.clear();
+        Afx_streamDev& sd = devs[d];
+        string out;
+        int status = 1;
+        if (!daemon && (d >= afx_map.fxdevs.size() ||
+                        !afx_map.fxdevs[d].dev || !afx_map.fxdevs[d].present))
+            error = std::format("Device #{} out of range or not present", d);
+        else if (!sd.ring.Create())
+            error = "Can't create frame ring";
+        else if (daemon) {
+            if (!daemon->Request({"attach", std::to_string(d)}, out, status,
+                                 {sd.ring.MemFd(), sd.ring.EventFd()}) ||
+                status)
+                error = std::format("Device #{} attach failed: {}", d, out);
+        } else {
+            sd.reader = std::make_shared<AlienFX_SDK::Afx_shmReader>();
+            if (sd.reader->Attach(dup(sd.ring.MemFd()),
+                                  dup(sd.ring.EventFd())))
+                engine.AddEffect(afx_map.fxdevs[d].devID, sd.reader);
+            else
+                error = "Can't attach frame ring";
+        }
+        if (error.empty()) return &sd;
+        devs.erase(d);
+        failed.insert(d);
+        // text lines go on, their frames for it are counted as bad
+        if (!raw) cerr << "Error: " << error << "\n";
+        return nullptr;
+    };
+    // binary frames go to one device, it has to work from the start
+    if (raw && !open(rawDev)) throw std::runtime_error(error);
+    if (!daemon) engine.Start();
+
+    struct sigaction sa{}, oldInt;
+    sa.sa_handler = [](int) { streamStop = 1; };
+    // no SA_RESTART, so read is interrupted
+    sigaction(SIGINT, &sa, &oldInt);
+    streamStop = 0;
+
+    string input;
+    char chunk[65536];
+    unsigned frames = 0, bad = 0;
+    uint64_t start = 0;
+    while (!streamStop) {
+        ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        uint64_t now = AlienFX_SDK::Engine::Now();
+        if (!start) start = now;
+        input.append(chunk, (size_t)n);
+        size_t used = 0;
+        if (raw) {
+            // older complete frames are replaced by the latest one
+            size_t size = raw * 3, count = input.size() / size;
+            if (count) {
+                Afx_streamDev& sd = *open(rawDev);
+                const char* f = input.data() + (count - 1) * size;
+                for (unsigned i = 0; i < raw; i++, f += 3)
+                    sd.state[i] = {(uint8_t)f[2], (uint8_t)f[1],
+                                   (uint8_t)f[0], 255};
+                sd.changed = true;
+                sd.frames += count;
+                frames += count;
+                used = count * size;
+            }
+        } else {
+            // every line changes its lights, later lines over earlier ones
+            for (size_t eol; (eol = input.find('\n', used)) != string::npos;
+                 used = eol + 1) {
+                std::istringstream line(input.substr(used, eol - used));
+                vector<Afx_streamDev*> touched;
+                unsigned d, lid, r, g, b;
+                bool ok = true;
+                while (line >> d) {
+                    if (!(line >> lid >> r >> g >> b) ||
+                        lid >= AFX_FRAME_LIGHTS || r > 255 || g > 255 ||
+                        b > 255) {
+                        ok = false;
+                        break;
+                    }
+                    // unknown device is a bad line, as bad light is
+                    Afx_streamDev* dev = open(d);
+                    if (!dev) {
+                        ok = false;
+                        break;
+                    }
+                    Afx_streamDev& sd = *dev;
+                    sd.state[lid] = {(uint8_t)b, (uint8_t)g, (uint8_t)r, 255};
+                    sd.changed = true;
+                    if (std::find(touched.begin(), touched.end(), &sd) ==
+                        touched.end())
+                        touched.push_back(&sd);
+                }
+                if (!ok || !line.eof()) {
+                    bad++;
+                    continue;
+                }
+                for (auto* sd : touched) sd->frames++;
+                if (touched.size()) frames++;
+            }
+        }
+        input.erase(0, used);
+        for (auto& [d, sd] : devs) {
+            if (!sd.changed) continue;
+            memcpy(sd.ring.Begin(), sd.state, sizeof(sd.state));
+            sd.ring.Commit(now);
+            sd.changed = false;
+        }
+        if (!daemon) engine.Tick();
+    }
+    sigaction(SIGINT, &oldInt, nullptr);
+
+    // last frame has to reach devices before they are released
+    if (daemon) {
+        for (int wait = 0; wait < 1000; wait++) {
+            bool pending = false;
+            for (auto& [d, sd] : devs) pending = pending || sd.ring.Pending();
+            if (!pending) break;
+            usleep(1000);
+        }
+    } else {
+        engine.Flush();
+    }
+    double secs = start ? (AlienFX_SDK::Engine::Now() - start) / 1e6 : 0;
+    cout << frames << " frames in " << secs << " s";
+    if (bad) cout << ", " << bad << " bad lines";
+    cout << "\n";
+    for (auto& [d, sd] : devs) {
+        unsigned shown = sd.ring.Taken();
+        if (!daemon) {
+            // frames replaced while device was busy
+            unsigned busy =
+                engine.GetStats(afx_map.fxdevs[d].devID).dropped;
+            shown -= std::min(shown, busy);
+        }
+        cout << "Device #" << d << ": " << sd.frames << " frames, " << shown
+             << " shown (" << (secs > 0 ? shown / secs : 0) << " fps), "
+             << sd.frames - std::min(shown, sd.frames) << " dropped\n";
+    }
+    engine.Stop();
+}
+
+static int RunCli(int argc, char** argv) {
     std::string desciption = std::format(
         "AlienFX CLI v{} \n Control all of your Alienware device from the "
         "comfort of your terminal",
@@ -133,17 +425,37 @@ int main(int argc, char** argv) {
     argv = app.ensure_utf8(argv);
     app.set_version_flag("-v", string("alienfx-cli v") + VERSION);
 
-    bool needInit = true;
-    auto ensureInit = [&]() {
-        if (needInit) {
+    bool direct = false;
+    // arguments for daemon, batch sends its lines instead of file name
+    vector<string> forward(argv + 1, argv + argc);
+    // remote - command can run at daemon (not interactive)
+    auto ensureInit = [&](bool remote = true) {
+        if (inDaemon && !remote)
+            throw std::runtime_error("Interactive command, run it directly");
+        if (onDeviceAccess) onDeviceAccess();
+        if (!inDaemon && !initDone) {
+            int status;
+            if (remote && !direct && RunAtDaemon(forward, status)) {
+                std::exit(status);
+            }
             initCli();
-            needInit = false;
+            initDone = true;
         }
     };
+    // hardware effects would fight with daemon compositor
+    auto noLayer = []() {
+        if (curLayer)
+            throw std::runtime_error("Only colors can be set with layer");
+    };
+    // batch lines inherit batch options
     app.add_option("--brightness", globalBright, "Global brightness 0-255")
-        ->default_val(255);
-    app.add_option("--tempo", sleepy, "Tempo for actions")->default_val(5);
-    app.add_option("--length", longer, "Length for actions")->default_val(5);
+        ->default_val(inLine ? (int)globalBright : 255);
+    app.add_option("--tempo", sleepy, "Tempo for actions")
+        ->default_val(inLine ? (int)sleepy : 5);
+    app.add_option("--length", longer, "Length for actions")
+        ->default_val(inLine ? (int)longer : 5);
+    app.add_flag("--direct", direct,
+                 "Access devices directly even if alienfxd is running");
 
     // setall r g b
     auto* cmd_setall = app.add_subcommand("setall", "r g b - set all lights");
@@ -152,7 +464,17 @@ int main(int argc, char** argv) {
     cmd_setall->add_option("g", g)->required()->check(CLI::Range(0, 255));
     cmd_setall->add_option("b", b)->required()->check(CLI::Range(0, 255));
     cmd_setall->callback([&]() {
-        ensureInit();
+        // layer clients paint their layer, devices are not touched
+        if (!curLayer) ensureInit();
+        if (curLayer) {
+            for (auto& dev : afx_map.fxdevs)
+                for (auto& l : dev.lights)
+                    if (!(l.flags & ALIENFX_FLAG_POWER))
+                        compositor->SetLight(
+                            curLayer, dev.devID, (uint8_t)l.lightid,
+                            {(uint8_t)b, (uint8_t)g, (uint8_t)r, 255});
+            return;
+        }
         auto act =
             MakeColorAction(r, g, b, AlienFX_SDK::Action::AlienFX_A_Color);
 
@@ -164,7 +486,10 @@ int main(int argc, char** argv) {
                     lights.push_back((uint8_t)l.lightid);
                 }
             }
-            dev.dev->SetMultiColor(&lights, act);
+            if (batch)
+                Queue(dev, lights, {act});
+            else
+                dev.dev->SetMultiColor(&lights, act);
         }
         Update();
     });
@@ -184,17 +509,26 @@ int main(int argc, char** argv) {
     cmd_setone->add_option("g", g2)->required()->check(CLI::Range(0, 255));
     cmd_setone->add_option("b", b2)->required()->check(CLI::Range(0, 255));
     cmd_setone->callback([&]() {
-        ensureInit();
+        if (!curLayer) ensureInit();
         if ((size_t)devIndex >= afx_map.fxdevs.size())
             throw CLI::ValidationError("dev", "Device index out of range");
 
         auto& dev = afx_map.fxdevs[(size_t)devIndex];
+        if (curLayer) {
+            compositor->SetLight(curLayer, dev.devID, (uint8_t)lightId,
+                                 {(uint8_t)b2, (uint8_t)g2, (uint8_t)r2, 255});
+            return;
+        }
         if (!dev.dev) throw std::runtime_error("Device not initialized");
 
         AlienFX_SDK::Afx_lightblock block{
             (uint8_t)lightId,
             {MakeColorAction(r2, g2, b2,
                              AlienFX_SDK::Action::AlienFX_A_Color)}};
+        if (batch) {
+            Queue(dev, {block.index}, block.act);
+            return;
+        }
         dev.dev->SetAction(&block);
         dev.dev->UpdateColors();
     });
@@ -209,13 +543,18 @@ int main(int argc, char** argv) {
     cmd_setzone->add_option("g", zg)->required()->check(CLI::Range(0, 255));
     cmd_setzone->add_option("b", zb)->required()->check(CLI::Range(0, 255));
     cmd_setzone->callback([&]() {
-        ensureInit();
+        if (!curLayer) ensureInit();
         unsigned zoneCode = GetZoneCodeFromString(zone);
         auto* grp = afx_map.GetGroupById(zoneCode);
         if (!grp) {
             LOG_F(ERROR, "Zone/group not found: %s", zone.c_str());
             return;
         }
+        if (curLayer) {
+            compositor->SetGroup(curLayer, zoneCode,
+                                 {(uint8_t)zb, (uint8_t)zg, (uint8_t)zr, 255});
+            return;
+        }
 
         auto act =
             MakeColorAction(zr, zg, zb, AlienFX_SDK::Action::AlienFX_A_Color);
@@ -225,7 +564,10 @@ int main(int argc, char** argv) {
             for (auto& gl : grp->lights) {
                 if (gl.did == dev.pid) lights.push_back((uint8_t)gl.lid);
             }
-            dev.dev->SetMultiColor(&lights, act);
+            if (batch)
+                Queue(dev, lights, {act});
+            else
+                dev.dev->SetMultiColor(&lights, act);
         }
         Update();
     });
@@ -245,12 +587,17 @@ int main(int argc, char** argv) {
     cmd_setaction->add_option("actions", sa_tokens)->required()->expected(-1);
     cmd_setaction->callback([&]() {
         ensureInit();
+        noLayer();
         if ((size_t)sa_dev >= afx_map.fxdevs.size())
             throw CLI::ValidationError("dev", "Device index out of range");
 
         auto actions = ParseActionList(sa_tokens);
         AlienFX_SDK::Afx_lightblock block{(uint8_t)sa_light, actions};
-        afx_map.fxdevs[(size_t)sa_dev].dev->SetAction(&block);
+        auto& dev = afx_map.fxdevs[(size_t)sa_dev];
+        if (batch)
+            Queue(dev, {block.index}, actions);
+        else
+            dev.dev->SetAction(&block);
         Update();
     });
 
@@ -265,13 +612,13 @@ int main(int argc, char** argv) {
     cmd_setzoneact->add_option("actions", sza_tokens)->required()->expected(-1);
     cmd_setzoneact->callback([&]() {
         ensureInit();
+        noLayer();
         unsigned zoneCode = GetZoneCodeFromString(sza_zone);
         auto* grp = afx_map.GetGroupById(zoneCode);
         // if (!grp) throw std::runtime_error("Zone/group not found");
-        if (!grp) {
-            LOG_F(ERROR, "Zone/group not found: %s", sza_zone.c_str());
-            std::exit(1);
-        }
+        if (!grp)
+            throw CLI::ValidationError("zone",
+                                       "Zone/group not found: " + sza_zone);
 
         auto actions = ParseActionList(sza_tokens);
         AlienFX_SDK::Afx_lightblock block{0, actions};
@@ -280,7 +627,10 @@ int main(int argc, char** argv) {
             auto* dev = afx_map.GetDeviceById(gl.did);
             if (!dev || !dev->dev) continue;
             block.index = (uint8_t)gl.lid;
-            dev->dev->SetAction(&block);
+            if (batch)
+                Queue(*dev, {block.index}, actions);
+            else
+                dev->dev->SetAction(&block);
         }
         Update();
     });
@@ -292,7 +642,16 @@ int main(int argc, char** argv) {
     cmd_setdim->add_option("args", dim_args)->required()->expected(1, 2);
     cmd_setdim->callback([&]() {
         ensureInit();
+        noLayer();
         int br = 0;
+        if (dim_args.size() > 1 &&
+            (dim_args[0] < 0 || (size_t)dim_args[0] >= afx_map.fxdevs.size()))
+            throw CLI::ValidationError("dev", "Device index out of range");
+        // brightness goes after batch colors
+        if (batch) {
+            batch->deferred.push_back(batch->line);
+            return;
+        }
         if (dim_args.size() == 1) {
             br = dim_args[0];
             // all devices
@@ -303,8 +662,6 @@ int main(int argc, char** argv) {
         } else {
             int d = dim_args[0];
             br = dim_args[1];
-            if (d < 0 || (size_t)d >= afx_map.fxdevs.size())
-                throw CLI::ValidationError("dev", "Device index out of range");
             auto& dev = afx_map.fxdevs[(size_t)d];
             dev.brightness = (uint8_t)br;
             afx_map.SetDeviceBrightness(&dev, globalBright, false);
@@ -318,9 +675,14 @@ int main(int argc, char** argv) {
     cmd_setglobal->add_option("args", gargs)->required()->expected(3, 9);
     cmd_setglobal->callback([&]() {
         ensureInit();
+        noLayer();
         int dev = gargs[0];
         if (dev < 0 || (size_t)dev >= afx_map.fxdevs.size())
             throw CLI::ValidationError("dev", "Device index out of range");
+        if (batch) {
+            batch->deferred.push_back(batch->line);
+            return;
+        }
 
         uint8_t cmode = gargs.size() < 6 ? 3 : (gargs.size() < 9 ? 1 : 2);
         while (gargs.size() < 9) gargs.push_back(0);
@@ -331,6 +693,149 @@ int main(int argc, char** argv) {
             {(uint8_t)gargs[6], (uint8_t)gargs[7], (uint8_t)gargs[8]});
     });
 
+    // flash zone r g b - notification overlay
+    auto* cmd_flash = app.add_subcommand(
+        "flash", "zone r g b - flash zone lights over current colors");
+    string fl_zone;
+    int fr = 0, fg = 0, fb = 0;
+    unsigned fl_count = 3, fl_on = 200, fl_off = 200;
+    cmd_flash->add_option("zone", fl_zone)->required();
+    cmd_flash->add_option("r", fr)->required()->check(CLI::Range(0, 255));
+    cmd_flash->add_option("g", fg)->required()->check(CLI::Range(0, 255));
+    cmd_flash->add_option("b", fb)->required()->check(CLI::Range(0, 255));
+    cmd_flash->add_option("--count", fl_count, "Flashes")
+        ->default_val(3)
+        ->check(CLI::PositiveNumber);
+    cmd_flash->add_option("--on", fl_on, "Flash time, ms")->default_val(200);
+    cmd_flash->add_option("--off", fl_off, "Pause time, ms")->default_val(200);
+    cmd_flash->callback([&]() {
+        // daemon shows overlay over running effects and layers
+        if (!inDaemon) ensureInit();
+        auto* grp = afx_map.GetGroupById(GetZoneCodeFromString(fl_zone));
+        if (!grp)
+            throw CLI::ValidationError("zone",
+                                       "Zone/group not found: " + fl_zone);
+        AlienFX_SDK::Afx_flash flash{
+            grp->lights,
+            {(uint8_t)fb, (uint8_t)fg, (uint8_t)fr, 255},
+            fl_on,
+            fl_off,
+            fl_count};
+        if (daemonFlash) {
+            if (!daemonFlash(flash))
+                throw std::runtime_error("No zone lights present");
+            return;
+        }
+        AlienFX_SDK::Engine engine(&afx_map, 60);
+        engine.Start();
+        if (!engine.Flash(flash))
+            throw std::runtime_error("No zone lights present");
+        while (engine.Flashing()) usleep(10000);
+        engine.Stop();
+    });
+
+    // stream [--raw lights] [--dev dev] - frames from stdin
+    auto* cmd_stream = app.add_subcommand(
+        "stream",
+        "Set lights from frames read from stdin, as fast as devices take "
+        "them (latest frame wins)");
+    unsigned st_raw = 0, st_dev = 0;
+    cmd_stream
+        ->add_option("--raw", st_raw,
+                     "Binary frames of r g b bytes for lights 0..raw-1, "
+                     "instead of text lines of dev light r g b tuples")
+        ->check(CLI::Range(1, AFX_FRAME_LIGHTS));
+    cmd_stream->add_option("--dev", st_dev, "Device for binary frames")
+        ->default_val(0);
+    cmd_stream->callback([&]() {
+        // stream goes into daemon layer, devices are not reopened
+        AlienFX_SDK::Afx_ipcClient client;
+        bool remote = !inDaemon && !direct && client.Connect();
+        if (!remote) ensureInit(false);
+        StreamFrames(remote ? &client : nullptr, st_raw, st_dev);
+    });
+
+    // events [type]... - print events as they happen
+    auto* cmd_events = app.add_subcommand(
+        "events",
+        "[device|profile|sensor[:C]|effect]... - print events as they "
+        "happen, until Ctrl-C");
+    vector<string> ev_types;
+    cmd_events->add_option("types", ev_types, "Event types, all if none");
+    cmd_events->callback([&]() {
+        int threshold = 90;
+        int mask = ParseEventTypes(ev_types, threshold);
+        AlienFX_SDK::Afx_ipcClient client;
+        if (!inDaemon && !direct && client.Connect()) {
+            vector<string> req{"events"};
+            req.insert(req.end(), ev_types.begin(), ev_types.end());
+            string out;
+            int status = 1;
+            if (!client.Request(req, out, status) || status)
+                throw std::runtime_error("Subscription failed: " + out);
+            for (string ev; client.ReadEvent(ev);) cout << ev << endl;
+            return;
+        }
+        ensureInit(false);
+        AlienFX_SDK::Afx_events bus(&afx_map);
+        bus.Subscribe(mask, [](const AlienFX_SDK::Afx_event& ev) {
+            cout << AlienFX_SDK::Afx_eventText(ev) << endl;
+        });
+        if (mask & AFX_EVENT_SENSOR) WatchSensors(bus, threshold);
+        if (!bus.Start()) throw std::runtime_error("Can't watch events");
+        for (;;) pause();
+    });
+
+    // batch [command]... - light commands as one transaction per device
+    auto* cmd_batch = app.add_subcommand(
+        "batch",
+        "[command]... - run light commands at once, one per argument, or "
+        "one per line of file or stdin");
+    vector<string> bt_lines;
+    string bt_file;
+    cmd_batch->add_option("commands", bt_lines, "Commands");
+    cmd_batch->add_option("-f,--file", bt_file,
+                          "Commands file, - for stdin (default)");
+    cmd_batch->callback([&]() {
+        if (bt_lines.empty()) {
+            // daemon only gets lines, it does not read client files
+            if (inDaemon) throw std::runtime_error("No commands");
+            std::ifstream file;
+            if (!bt_file.empty() && bt_file != "-") {
+                file.open(bt_file);
+                if (!file)
+                    throw std::runtime_error("Can't open " + bt_file);
+            }
+            istream& in = file.is_open() ? file : cin;
+            for (string line; getline(in, line);) bt_lines.push_back(line);
+        }
+        forward = {"batch"};
+        forward.insert(forward.end(), bt_lines.begin(), bt_lines.end());
+        if (!curLayer) ensureInit();
+        // parse all lines first, bad line leaves devices untouched
+        Afx_batch tx;
+        batch = &tx;
+        for (size_t i = 0; i < bt_lines.size(); i++) {
+            tx.line = SplitLine(bt_lines[i]);
+            if (tx.line.empty() || tx.line[0][0] == '#') continue;
+            if (RunLine(tx.line)) {
+                batch = nullptr;
+                throw std::runtime_error(
+                    std::format("Line {}: {}", i + 1, bt_lines[i]));
+            }
+        }
+        batch = nullptr;
+        for (auto& [dev, lights] : tx.lights) {
+            if (!dev->dev || !dev->present) continue;
+            vector<AlienFX_SDK::Afx_lightblock> blocks;
+            for (auto& [lid, act] : lights) blocks.push_back({lid, act});
+            dev->dev->SetMultiAction(&blocks);
+            dev->dev->UpdateColors();
+        }
+        for (auto& line : tx.deferred)
+            if (RunLine(line)) throw std::runtime_error("Command failed");
+    });
+
     // status
     auto* cmd_status =
         app.add_subcommand("status", "Show devices, lights and zones");
@@ -339,12 +844,14 @@ int main(int argc, char** argv) {
         for (auto it = afx_map.fxdevs.begin(); it < afx_map.fxdevs.end();
              it++) {
             cout << "Device #" << (it - afx_map.fxdevs.begin()) << " - "
-                 << it->name << ", VID#0x" << std::hex << it->vid << std::dec
+                 << afx_map.names.Get(it->nameid) << ", VID#0x" << std::hex
+                 << it->vid << std::dec
                  << ", PID#0x" << std::hex << it->pid << std::dec << ", APIv"
                  << (int)it->version << ", " << it->lights.size() << " lights"
                  << (it->present ? "" : " (inactive)") << "\n";
             for (const auto& l : it->lights) {
-                cout << "  Light ID#" << (int)l.lightid << " - " << l.name
+                cout << "  Light ID#" << (int)l.lightid << " - "
+                     << afx_map.names.Get(l.nameid)
                      << ((l.flags & ALIENFX_FLAG_POWER) ? " (Power button)"
                                                         : "")
                      << ((l.flags & ALIENFX_FLAG_INDICATOR) ? " (Indicator)"
@@ -358,7 +865,8 @@ int main(int argc, char** argv) {
             for (size_t i = 0; i < afx_map.GetGroups()->size(); i++) {
                 const auto& g = afx_map.GetGroups()->at(i);
                 cout << "  Zone #" << (g.gid) << " (" << g.lights.size()
-                     << " lights) - " << g.name << "\n";
+                     << " lights) - " << afx_map.names.Get(g.nameid)
+                     << "\n";
             }
         }
     });
@@ -375,7 +883,7 @@ int main(int argc, char** argv) {
     cmd_probe->add_option("--light", probe_light,
                           "Only probe a specific light id");
     cmd_probe->callback([&]() {
-        ensureInit();
+        ensureInit(false);
 
         for (auto& d : afx_map.fxdevs) {
             cout << "===== Device VID 0x" << std::hex << d.vid << ", PID 0x"
@@ -395,9 +903,14 @@ int main(int argc, char** argv) {
 
             cout << "Probing device VID 0x" << std::hex << cDev.vid
                  << ", PID 0x" << cDev.pid << std::dec << ", current name "
-                 << cDev.name << ", New name (ENTER to skip): ";
+                 << afx_map.names.Get(cDev.nameid)
+                 << ", New name (ENTER to skip): ";
             auto newDevName = ReadLineTrimmed();
-            if (!newDevName.empty()) cDev.name = newDevName;
+            if (!newDevName.empty()) {
+                std::lock_guard<std::recursive_mutex> lock(afx_map.mapLock);
+                cDev.nameid = afx_map.names.Intern(newDevName);
+                afx_map.MarkDirty(ALIENFX_MAP_DEVICES);
+            }
 
             int fnumlights = (probe_lights != -1)
                                  ? probe_lights
@@ -413,24 +926,27 @@ int main(int argc, char** argv) {
                 lon.act.front().g = 255;
 
                 auto* lmap = afx_map.GetMappingByDev(&cDev, (unsigned short)li);
-                if (lmap) cout << ", current name " << lmap->name;
+                if (lmap)
+                    cout << ", current name "
+                         << afx_map.names.Get(lmap->nameid);
 
                 cout << ", New name (ENTER to skip): ";
 
                 std::vector<AlienFX_SDK::Afx_light> light;
-                light.push_back({(uint8_t)li, 0x0000, 0x0000, "test"});
+                light.push_back({(uint8_t)li, 0x0000, 0x0000});
                 cDev.dev->SetBrightness(255, globalBright, &light, false);
                 cDev.dev->SetAction(&lon);
                 cDev.dev->UpdateColors();
 
                 auto newLightName = ReadLineTrimmed();
                 if (!newLightName.empty()) {
+                    std::lock_guard<std::recursive_mutex> lock(afx_map.mapLock);
+                    auto nameid = afx_map.names.Intern(newLightName);
                     if (lmap)
-                        lmap->name = newLightName;
+                        lmap->nameid = nameid;
                     else
-                        cDev.lights.push_back(
-                            {(uint8_t)li, {0, 0}, newLightName});
-                    afx_map.SaveMappings();
+                        cDev.lights.push_back({(uint8_t)li, {0, 0}, nameid});
+                    afx_map.MarkDirty(ALIENFX_MAP_LIGHTS);
                     cout << "Saved.\n";
                 } else {
                     cout << "Skipped.\n";
@@ -440,15 +956,15 @@ int main(int argc, char** argv) {
                 cDev.dev->SetAction(&lon);
                 cDev.dev->UpdateColors();
             }
-            afx_map.SaveMappings();
         }
+        afx_map.Flush();
     });
 
     // createlightzone
     auto* cmd_createlightzone = app.add_subcommand(
         "createlightzone", "Interactively create a light zone/group");
     cmd_createlightzone->callback([&]() {
-        ensureInit();
+        ensureInit(false);
 
         cout << "Zone name: ";
         string zoneName = ReadLineTrimmed();
@@ -460,7 +976,7 @@ int main(int argc, char** argv) {
         // Check if zone name already exists
         auto* groups = afx_map.GetGroups();
         for (const auto& g : *groups) {
-            if (g.name == zoneName) {
+            if (afx_map.names.Get(g.nameid) == zoneName) {
                 cout << "Zone '" << zoneName
                      << "' already exists. Overwrite? (y/N) ";
                 auto ans = ReadLineTrimmed();
@@ -470,7 +986,7 @@ int main(int argc, char** argv) {
                 }
                 // Remove existing zone
                 for (auto it = groups->begin(); it != groups->end(); ++it) {
-                    if (it->name == zoneName) {
+                    if (afx_map.names.Get(it->nameid) == zoneName) {
                         groups->erase(it);
                         break;
                     }
@@ -542,7 +1058,7 @@ int main(int argc, char** argv) {
         // Build the new group
         AlienFX_SDK::Afx_group newGroup;
         newGroup.gid = newGid;
-        newGroup.name = zoneName;
+        newGroup.nameid = afx_map.names.Intern(zoneName);
         newGroup.lights.clear();
 
         for (int lid : lightIds) {
@@ -554,6 +1070,7 @@ int main(int argc, char** argv) {
 
         // Add to groups and save
         groups->push_back(newGroup);
+        afx_map.layoutGen++;
         afx_map.SaveMappings();
 
         cout << "Created zone '" << zoneName << "' (gid=" << newGid << ") with "
@@ -603,8 +1120,376 @@ int main(int argc, char** argv) {
         }
     });
 
+    // only commands setting lights can be batched or run by daemon, others
+    // run in client process with its user rights
+    for (auto* cmd : {cmd_stream, cmd_events, cmd_probe, cmd_createlightzone,
+                      cmd_getpp, cmd_supported, cmd_setpp})
+        cmd->disabled(batch != nullptr || inDaemon);
+    for (auto* cmd : {cmd_flash, cmd_batch, cmd_status})
+        cmd->disabled(batch != nullptr);
+
     app.require_subcommand(1);
 
-    CLI11_PARSE(app, argc, argv);
+    try {
+        CLI11_PARSE(app, argc, argv);
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef ALIENFX_DAEMON
+static AlienFX_SDK::Afx_ipcServer server;
+
+// Engine for client layers and overlays, runs while any of them exists
+static AlienFX_SDK::Engine engine(&afx_map, 60);
+static bool engineOn = false,
+            paused = false;  // stopped for current command
+
+static void StartEngine() {
+    if (!engineOn) engine.Start();
+    engineOn = true;
+}
+
+static void StopEngine() {
+    engine.Stop();
+    engineOn = false;
+}
+
+// Mappings lock held while command runs. Engine thread locks engine, then
+// mappings, so engine is started or stopped only with it released.
+static std::unique_lock<std::recursive_mutex> mapGuard(afx_map.mapLock,
+                                                       std::defer_lock);
+// Overlays requested by command, shown after mappings lock is released
+static vector<AlienFX_SDK::Afx_flash> flashes;
+
+struct Afx_client {  // Client with own layer
+    unsigned layer;
+    vector<std::shared_ptr<AlienFX_SDK::Afx_shmReader>> rings;
+};
+static std::map<int, Afx_client> clients;
+
+static const char* blendNames[AFX_BLEND_COUNT]{"normal", "add", "multiply",
+                                               "max"};
+
+// Event subscriptions of clients. Bus runs in server loop, so events are
+// sent from server thread.
+struct Afx_subscription {
+    int mask;                  // AFX_EVENT_* types
+    vector<unsigned> sensors;  // own sensor watches
+};
+static std::map<int, Afx_subscription> subscribers;
+static AlienFX_SDK::Afx_events bus(&afx_map);
+
+static void StopDaemon(int) { server.Stop(); }
+
+// Signalled by mappings watch thread after external edit is merged
+static int reloadFd = -1;
+
+// Apply merged devices and light lists between requests, with engine
+// stopped, as it renders with light and device pointers
+static void ApplyReload() {
+    uint64_t cnt;
+    if (read(reloadFd, &cnt, sizeof(cnt)) < 0 || !afx_map.MergePending())
+        return;
+    bool running = engineOn;
+    if (running) engine.Stop();
+    afx_map.ApplyMerged();
+    if (running) engine.Start();
+}
+
+// Plugged device starts at default brightness, set it up as initCli does
+static void SetupDevice(const AlienFX_SDK::Afx_event& ev) {
+    bool running = engineOn;
+    if (running) engine.Stop();
+    {
+        std::lock_guard<std::recursive_mutex> lock(afx_map.mapLock);
+        if (auto* dev = afx_map.GetDeviceById(ev.devID))
+            afx_map.SetDeviceBrightness(dev, 255, true);
+    }
+    if (running) engine.Start();
+}
+
+// Simulate mapped devices not found, to test daemon without hardware
+static void SimulateDevices(int version) {
+    for (auto& dev : afx_map.fxdevs) {
+        if (dev.present || dev.dev) continue;
+        auto* fn = new AlienFX_SDK::Functions();
+        if (!fn->AlienFXSimulate(dev.vid, dev.pid, version)) {
+            LOG_F(ERROR, "Can't simulate API version %d", version);
+            delete fn;
+            return;
+        }
+        dev.dev = fn;
+        dev.version = version;
+        dev.present = true;
+        afx_map.activeDevices++;
+        afx_map.activeLights += (unsigned)dev.lights.size();
+    }
+}
+
+static void SendEvent(const AlienFX_SDK::Afx_event& ev) {
+    string text = AlienFX_SDK::Afx_eventText(ev);
+    vector<int> to;
+    for (auto& [client, sub] : subscribers)
+        if ((sub.mask & ev.type) &&
+            (ev.type != AFX_EVENT_SENSOR ||
+             std::count(sub.sensors.begin(), sub.sensors.end(), ev.id)))
+            to.push_back(client);
+    // client which can't take event is dropped, with its subscription
+    for (int client : to) server.Send(client, text);
+}
+
+static void Unsubscribe(int client) {
+    auto sub = subscribers.find(client);
+    if (sub == subscribers.end()) return;
+    for (unsigned id : sub->second.sensors) bus.UnwatchSensor(id);
+    subscribers.erase(sub);
+}
+
+// events [type]... - push events to client until it disconnects
+static int Events(const vector<string>& args, string& out) {
+    int threshold = 90, mask;
+    try {
+        mask = ParseEventTypes(vector<string>(args.begin() + 1, args.end()),
+                               threshold);
+    } catch (const std::exception& e) {
+        out = string(e.what()) + "\n";
+        return 1;
+    }
+    Unsubscribe(server.Client());
+    Afx_subscription& sub = subscribers[server.Client()];
+    sub.mask = mask;
+    if (mask & AFX_EVENT_SENSOR) sub.sensors = WatchSensors(bus, threshold);
+    return 0;
+}
+
+// Layer of current client, created on first use
+static Afx_client& GetClient() {
+    auto c = clients.find(server.Client());
+    if (c != clients.end()) return c->second;
+    if (clients.empty()) {
+        // compositor owns all devices while layers exist
+        vector<uint32_t> devs;
+        {
+            std::lock_guard<std::recursive_mutex> lock(afx_map.mapLock);
+            for (auto& dev : afx_map.fxdevs)
+                if (dev.dev && dev.present) devs.push_back(dev.devID);
+        }
+        for (uint32_t id : devs) engine.AddEffect(id, compositor);
+        StartEngine();
+    }
+    return clients[server.Client()] = {compositor->AddLayer(0), {}};
+}
+
+// Drop layer and rings of disconnected client
+static void Detach(int client) {
+    auto c = clients.find(client);
+    if (c == clients.end()) return;
+    for (auto& ring : c->second.rings) server.RemoveWatch(ring->EventFd());
+    compositor->RemoveLayer(c->second.layer);
+    clients.erase(c);
+    if (clients.empty()) {
+        // devices keep last composed colors, next layers start clean
+        engine.Flush();
+        if (!engine.Flashing()) StopEngine();
+        engine.ClearEffects();
+        compositor = std::make_shared<AlienFX_SDK::Afx_compositor>(&afx_map);
+    }
+}
+
+// layer priority [blend] - create or change client layer
+static int Layer(const vector<string>& args, string& out) {
+    if (args.size() < 2 || args.size() > 3) {
+        out = "Usage: layer priority [normal|add|multiply|max]\n";
+        return 1;
+    }
+    int blend = AFX_BLEND_NORMAL;
+    if (args.size() > 2) {
+        auto name = std::find(blendNames, blendNames + AFX_BLEND_COUNT,
+                              args[2]);
+        if (name == blendNames + AFX_BLEND_COUNT) {
+            out = "Unknown blend mode: " + args[2] + "\n";
+            return 1;
+        }
+        blend = (int)(name - blendNames);
+    }
+    unsigned layer = GetClient().layer;
+    compositor->SetPriority(layer, atoi(args[1].c_str()));
+    compositor->SetBlend(layer, blend);
+    return 0;
+}
+
+// mask [zone|dev:light]... - restrict client layer, no lights - unmask
+static int Mask(const vector<string>& args, string& out) {
+    vector<AlienFX_SDK::Afx_groupLight> lights;
+    std::unique_lock<std::recursive_mutex> lock(afx_map.mapLock);
+    for (size_t i = 1; i < args.size(); i++) {
+        size_t sep = args[i].find(':');
+        if (sep == string::npos) {
+            auto* grp = afx_map.GetGroupById(GetZoneCodeFromString(args[i]));
+            if (!grp) {
+                out = "Zone/group not found: " + args[i] + "\n";
+                return 1;
+            }
+            lights.insert(lights.end(), grp->lights.begin(),
+                          grp->lights.end());
+            continue;
+        }
+        size_t d = strtoul(args[i].c_str(), nullptr, 0);
+        if (d >= afx_map.fxdevs.size()) {
+            out = "Device index out of range: " + args[i] + "\n";
+            return 1;
+        }
+        lights.push_back(
+            {{afx_map.fxdevs[d].pid,
+              (unsigned short)strtoul(args[i].c_str() + sep + 1, nullptr,
+                                      0)}});
+    }
+    lock.unlock();
+    compositor->SetMask(GetClient().layer, lights);
+    return 0;
+}
+
+// attach dev - render frames from client ring into client layer, ring memfd
+// and eventfd are sent with request
+static int Attach(const vector<string>& args, string& out) {
+    auto fds = server.TakeFds();
+    if (args.size() != 2 || fds.size() != 2) {
+        for (int fd : fds) close(fd);
+        out = "Usage: attach dev, with ring memfd and eventfd\n";
+        return 1;
+    }
+    auto ring = std::make_shared<AlienFX_SDK::Afx_shmReader>();
+    if (!ring->Attach(fds[0], fds[1])) {
+        out = "Bad frame ring\n";
+        return 1;
+    }
+    size_t d = strtoul(args[1].c_str(), nullptr, 0);
+    uint32_t devID;
+    {
+        // released before GetClient, it locks engine
+        std::lock_guard<std::recursive_mutex> lock(afx_map.mapLock);
+        if (d >= afx_map.fxdevs.size() || !afx_map.fxdevs[d].dev ||
+            !afx_map.fxdevs[d].present) {
+            out = "Device index out of range or device not present\n";
+            return 1;
+        }
+        devID = afx_map.fxdevs[d].devID;
+    }
+    Afx_client& client = GetClient();
+    compositor->SetSource(client.layer, devID, ring);
+    client.rings.push_back(ring);
+    // new frame renders at once, not at next tick
+    server.AddWatch(ring->EventFd(), [ring]() {
+        if (ring->Wake()) engine.Tick();
+    });
+    return 0;
+}
+
+// Run client command line, capturing its output
+static int RunRequest(const vector<string>& args, string& out) {
+    if (args.size() && args[0] == "layer") return Layer(args, out);
+    if (args.size() && args[0] == "mask") return Mask(args, out);
+    if (args.size() && args[0] == "attach") return Attach(args, out);
+    if (args.size() && args[0] == "events") return Events(args, out);
+    auto client = clients.find(server.Client());
+    curLayer = client != clients.end() ? client->second.layer : 0;
+    // overlays are over
+    if (engineOn && clients.empty() && !engine.Flashing()) StopEngine();
+    vector<char*> argv{(char*)"alienfxd"};
+    for (auto& a : args) argv.push_back((char*)a.c_str());
+    argv.push_back(nullptr);
+    ostringstream capture;
+    auto* oldOut = cout.rdbuf(capture.rdbuf());
+    auto* oldErr = cerr.rdbuf(capture.rdbuf());
+    mapGuard.lock();
+    int status = RunCli((int)args.size() + 1, argv.data());
+    mapGuard.unlock();
+    cout.rdbuf(oldOut);
+    cerr.rdbuf(oldErr);
+    out = capture.str();
+    curLayer = 0;
+    if (paused) engine.Start();
+    paused = false;
+    for (auto& flash : flashes) {
+        StartEngine();
+        if (!engine.Flash(flash)) {
+            out += "Error: No zone lights present\n";
+            status = 1;
+        }
+    }
+    flashes.clear();
+    return status;
+}
+
+// alienfxd [socket] - keep devices open and serve alienfx-cli commands
+int main(int argc, char** argv) {
+    inDaemon = true;
+    compositor = std::make_shared<AlienFX_SDK::Afx_compositor>(&afx_map);
+    string path = argc > 1 ? argv[1] : AlienFX_SDK::Afx_ipcPath();
+    // system daemon serves members of alienfx group
+    unsigned mode = 0600;
+    int gid = -1;
+    if (!getuid()) {
+        if (group* gr = getgrnam(AFX_IPC_GROUP)) {
+            mode = 0660;
+            gid = (int)gr->gr_gid;
+        } else
+            LOG_F(WARNING, "No %s group, only root can use daemon",
+                  AFX_IPC_GROUP);
+    }
+    if (!server.Listen(path, mode, gid)) return 1;
+    signal(SIGINT, StopDaemon);
+    signal(SIGTERM, StopDaemon);
+    initCli();
+    if (const char* sim = getenv("ALIENFXD_SIMULATE"))
+        SimulateDevices(atoi(sim));
+    reloadFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reloadFd >= 0) {
+        server.AddWatch(reloadFd, ApplyReload);
+        afx_map.onReload = [](int) {
+            uint64_t one = 1;
+            if (write(reloadFd, &one, sizeof(one)) < 0)
+                LOG_F(ERROR, "Failed to signal mappings reload");
+        };
+    }
+    // pick up zones and names changed by direct mode clients
+    afx_map.WatchMappings();
+    server.onClose = [](int client) {
+        Unsubscribe(client);
+        Detach(client);
+    };
+    // event sources are polled by server loop, no event thread
+    bus.Subscribe(AFX_EVENT_DEVICE_ADDED, SetupDevice);
+    bus.Subscribe(AFX_EVENT_ALL, SendEvent);
+    bus.WatchEngine(&engine);
+    if (bus.Start(1000, false))
+        server.AddWatch(bus.Fd(), []() { bus.Dispatch(); });
+    // devices are used by engine while it runs, so commands using them
+    // pause it
+    onDeviceAccess = []() {
+        if (engineOn && !paused) {
+            // command has not used mappings yet, engine thread can take them
+            mapGuard.unlock();
+            engine.Stop();
+            mapGuard.lock();
+            paused = true;
+        }
+    };
+    // Flash locks engine, then mappings
+    daemonFlash = [](const AlienFX_SDK::Afx_flash& flash) {
+        flashes.push_back(flash);
+        return 1u;
+    };
+    LOG_F(INFO, "Listening at %s", path.c_str());
+    server.Run(RunRequest);
+    server.Close();
+    bus.Stop();
+    afx_map.StopWatch();
     return 0;
 }
+#else
+int main(int argc, char** argv) { return RunCli(argc, argv); }
+#endif
@@ -0,0 +1,70 @@
+#!/bin/sh
+# Daemon keeps serving commands which pause the engine (setall) or show an
+# overlay (flash) while a stream is attached to a client layer, on a
+# simulated device.
+# Usage: daemon_locks.sh alienfxd alienfx_cli
+daemon=$1
+cli=$2
+tmp=$(mktemp -d)
+dpid=
+spid=
+cleanup() {
+    [ -n "$spid" ] && kill "$spid" 2>/dev/null
+    [ -n "$dpid" ] && kill "$dpid" 2>/dev/null
+    wait 2>/dev/null
+    rm -rf "$tmp"
+}
+trap cleanup EXIT
+fail() {
+    echo "FAIL: $*"
+    exit 1
+}
+
+export XDG_DATA_HOME="$tmp"
+export ALIENFX_SOCKET="$tmp/alienfxd.sock"
+mkdir -p "$tmp/alienfx"
+cat >"$tmp/alienfx/mappings.json" <<JSON
+{
+  "schemaVersion": 2,
+  "devices": [{
+    "vid": 6268, "pid": 1360, "name": "Simulated", "white": 4294967295,
+    "brightness": 255, "path": "", "caps": {"version": 5},
+    "lights": [
+      {"lightid": 0, "flags": 0, "scancode": 0, "name": "Light 0"},
+      {"lightid": 1, "flags": 0, "scancode": 0, "name": "Light 1"},
+      {"lightid": 2, "flags": 0, "scancode": 0, "name": "Light 2"},
+      {"lightid": 3, "flags": 0, "scancode": 0, "name": "Light 3"}
+    ]
+  }],
+  "groups": [{
+    "gid": 65537, "name": "test",
+    "lights": [{"did": 1360, "lid": 0}, {"did": 1360, "lid": 1},
+               {"did": 1360, "lid": 2}, {"did": 1360, "lid": 3}]
+  }],
+  "grids": []
+}
+JSON
+
+ALIENFXD_SIMULATE=5 "$daemon" "$ALIENFX_SOCKET" >"$tmp/daemon.log" 2>&1 &
+dpid=$!
+for i in $(seq 50); do
+    [ -S "$ALIENFX_SOCKET" ] && break
+    sleep 0.1
+done
+[ -S "$ALIENFX_SOCKET" ] || fail "daemon did not start"
+
+# frames keep coming, so engine ticks while commands run
+(while :; do
+    printf '\377\000\000\000\377\000\000\000\377\377\377\377'
+    sleep 0.01
+done) | "$cli" stream --raw 4 >/dev/null 2>&1 &
+spid=$!
+sleep 0.5
+
+for i in $(seq 20); do
+    timeout 5 "$cli" flash test 0 0 255 --count 1 --on 20 --off 20 ||
+        fail "flash $i"
+    timeout 5 "$cli" setall 0 255 0 || fail "setall $i"
+done
+timeout 5 "$cli" setone 0 1 255 0 0 || fail "daemon stopped answering"
+echo "OK"
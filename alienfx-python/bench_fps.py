@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Sustained frame rate from Python against a simulated device.
+
+Frames of changing colors for every light are submitted as bytes, as a
+bytearray updated in place and as a NumPy array (if NumPy is installed).
+The last run submits from a thread while the main thread counts in Python,
+to show submit runs without the GIL.
+
+Run from the build directory, or with PYTHONPATH pointing to the module:
+    python3 bench_fps.py [--version 5] [--lights 128] [--seconds 3]
+"""
+import argparse
+import threading
+import time
+
+import alienfx
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+
+def run(dev, frames, seconds):
+    """Submit frames in a loop, returns (fps, reports per frame)"""
+    before = dev.info()["reports"]
+    count = 0
+    start = time.perf_counter()
+    end = start + seconds
+    while time.perf_counter() < end:
+        for frame in frames:
+            dev.submit(frame)
+        count += len(frames)
+    took = time.perf_counter() - start
+    return count / took, (dev.info()["reports"] - before) / count
+
+
+def run_inplace(dev, lights, seconds):
+    """Update one bytearray in place, as a renderer would"""
+    frame = bytearray(lights * 3)
+    view = memoryview(frame)
+    before = dev.info()["reports"]
+    count = 0
+    start = time.perf_counter()
+    end = start + seconds
+    while time.perf_counter() < end:
+        step = count & 0xff
+        view[0::3] = bytes((step + i) & 0xff for i in range(lights))
+        dev.submit(frame)
+        count += 1
+    took = time.perf_counter() - start
+    return count / took, (dev.info()["reports"] - before) / count
+
+
+def count_python(seconds):
+    """Pure Python loop iterations per second"""
+    count = 0
+    end = time.perf_counter() + seconds
+    while time.perf_counter() < end:
+        count += 1
+    return count / seconds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--version", type=int, default=5, help="device API")
+    parser.add_argument("--lights", type=int, default=128)
+    parser.add_argument("--seconds", type=float, default=3)
+    args = parser.parse_args()
+
+    mappings = alienfx.Mappings.simulated(version=args.version,
+                                          lights=args.lights)
+    dev = mappings.devices()[0]
+    print(dev, f"{args.lights} lights")
+    # frames differ in every light, so each one is fully encoded
+    frames = [bytes((f + i) & 0xff for i in range(args.lights * 3))
+              for f in range(16)]
+
+    fps, reports = run(dev, frames, args.seconds)
+    print(f"bytes:     {fps:10.0f} fps, {reports:.1f} reports/frame")
+    fps, reports = run_inplace(dev, args.lights, args.seconds)
+    print(f"bytearray: {fps:10.0f} fps, {reports:.1f} reports/frame")
+    if numpy is not None:
+        base = numpy.arange(args.lights * 3, dtype=numpy.uint8)
+        arrays = [(base + f).reshape(args.lights, 3) for f in range(16)]
+        fps, reports = run(dev, arrays, args.seconds)
+        print(f"numpy:     {fps:10.0f} fps, {reports:.1f} reports/frame")
+    else:
+        print("numpy:     not installed")
+
+    alone = count_python(args.seconds)
+    result = []
+    thread = threading.Thread(
+        target=lambda: result.append(run(dev, frames, args.seconds)))
+    thread.start()
+    shared = count_python(args.seconds)
+    thread.join()
+    print(f"threaded:  {result[0][0]:10.0f} fps, Python loop at "
+          f"{shared / alone * 100:.0f}% of its speed alone")
+
+
+if __name__ == "__main__":
+    main()
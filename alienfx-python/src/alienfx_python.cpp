@@ -0,0 +1,467 @@
+// Python module "alienfx": light devices over the C interface (alienfx_c.h)
+// and fans over AlienFan SDK. Frame calls take any contiguous buffer (bytes,
+// bytearray, memoryview, NumPy array) without copying it, and run without
+// the GIL, so other Python threads keep going while reports are sent.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+#include <mutex>
+
+#include "AlienFan-SDK.h"
+#include "alienfx_c.h"
+
+struct Afx_pyMappings {
+    PyObject_HEAD
+    afx_context* ctx;
+    std::mutex* lock;  // context calls run without GIL
+};
+
+struct Afx_pyFunctions {
+    PyObject_HEAD
+    Afx_pyMappings* map;  // keeps context alive
+    int index;            // device index in context
+};
+
+struct Afx_pyControl {
+    PyObject_HEAD
+    AlienFan_SDK::Control* fan;
+};
+
+static PyTypeObject MappingsType, FunctionsType, ControlType;
+
+// Releases GIL for its scope, around device I/O
+struct Afx_pyNoGil {
+    PyThreadState* state = PyEval_SaveThread();
+    ~Afx_pyNoGil() { PyEval_RestoreThread(state); }
+};
+
+// Raise Python error for failed C interface call, returns NULL
+static PyObject* RaiseError(int code) {
+    const char* text = code == AFX_ERR_ARG      ? "Bad argument"
+                       : code == AFX_ERR_DEVICE ? "Device not present"
+                                                : "Device I/O failed";
+    if (code == AFX_ERR_ARG) PyErr_SetString(PyExc_ValueError, text);
+    else PyErr_SetString(PyExc_OSError, text);
+    return nullptr;
+}
+
+// ----------- Mappings ------------
+
+static PyObject* WrapContext(PyTypeObject* type, afx_context* ctx) {
+    if (!ctx) {
+        PyErr_SetString(PyExc_OSError, "Failed to open AlienFX devices");
+        return nullptr;
+    }
+    auto* self = (Afx_pyMappings*)type->tp_alloc(type, 0);
+    if (!self) {
+        afx_close(ctx);
+        return nullptr;
+    }
+    self->ctx = ctx;
+    self->lock = new std::mutex;
+    return (PyObject*)self;
+}
+
+static PyObject* Mappings_new(PyTypeObject* type, PyObject* args,
+                              PyObject* kw) {
+    if (!PyArg_ParseTuple(args, ":Mappings")) return nullptr;
+    afx_context* ctx;
+    {  // device enumeration opens USB devices
+        Afx_pyNoGil nogil;
+        ctx = afx_open();
+    }
+    return WrapContext(type, ctx);
+}
+
+static void Mappings_dealloc(Afx_pyMappings* self) {
+    if (self->ctx) afx_close(self->ctx);
+    delete self->lock;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Mappings_simulated(PyObject* cls, PyObject* args,
+                                    PyObject* kw) {
+    static const char* keys[]{"dev_id", "version", "lights", nullptr};
+    unsigned dev_id = 0x187c0550, lights = 128;
+    int version = 5;
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "|IiI:simulated",
+                                     (char**)keys, &dev_id, &version, &lights))
+        return nullptr;
+    return WrapContext((PyTypeObject*)cls,
+                       afx_open_simulated(dev_id, version, lights));
+}
+
+static PyObject* Mappings_rescan(Afx_pyMappings* self, PyObject*) {
+    int res;
+    {
+        Afx_pyNoGil nogil;
+        std::lock_guard<std::mutex> guard(*self->lock);
+        res = afx_rescan(self->ctx);
+    }
+    if (res < 0) return RaiseError(res);
+    return PyBool_FromLong(res);
+}
+
+static PyObject* Mappings_devices(Afx_pyMappings* self, PyObject*) {
+    int count;
+    {
+        std::lock_guard<std::mutex> guard(*self->lock);
+        count = afx_device_count(self->ctx);
+    }
+    PyObject* list = PyList_New(0);
+    for (int i = 0; list && i < count; i++) {
+        auto* dev = PyObject_New(Afx_pyFunctions, &FunctionsType);
+        if (!dev) {
+            Py_CLEAR(list);
+            break;
+        }
+        Py_INCREF(self);
+        dev->map = self;
+        dev->index = i;
+        if (PyList_Append(list, (PyObject*)dev)) Py_CLEAR(list);
+        Py_DECREF(dev);
+    }
+    return list;
+}
+
+static PyMethodDef Mappings_methods[]{
+    {"simulated", (PyCFunction)(void (*)())Mappings_simulated,
+     METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+     "simulated(dev_id=0x187c0550, version=5, lights=128)\n"
+     "Mappings with one simulated device: reports are encoded and counted,\n"
+     "but not sent. User mappings are not touched."},
+    {"rescan", (PyCFunction)Mappings_rescan, METH_NOARGS,
+     "Scan for plugged in or removed devices, True if list changed"},
+    {"devices", (PyCFunction)Mappings_devices, METH_NOARGS,
+     "Known devices (present or not), as Functions objects"},
+    {nullptr}};
+
+// ----------- Functions ------------
+
+static void Functions_dealloc(Afx_pyFunctions* self) {
+    Py_XDECREF(self->map);
+    PyObject_Free(self);
+}
+
+static bool GetInfo(Afx_pyFunctions* self, afx_device_info& info) {
+    info = {sizeof(info)};
+    std::lock_guard<std::mutex> guard(*self->map->lock);
+    return afx_get_device_info(self->map->ctx, self->index, &info) == AFX_OK;
+}
+
+static PyObject* Functions_info(Afx_pyFunctions* self, PyObject*) {
+    afx_device_info info;
+    if (!GetInfo(self, info)) return RaiseError(AFX_ERR_ARG);
+    return Py_BuildValue(
+        "{s:I,s:H,s:H,s:i,s:i,s:I,s:I,s:O,s:K,s:s}", "dev_id", info.dev_id,
+        "vid", info.vid, "pid", info.pid, "version", info.api_version,
+        "length", info.report_length, "lights", info.lights, "caps",
+        info.caps, "present", info.present ? Py_True : Py_False, "reports",
+        (unsigned long long)info.reports, "name", info.name);
+}
+
+static PyObject* Functions_lights(Afx_pyFunctions* self, PyObject*) {
+    afx_device_info info;
+    if (!GetInfo(self, info)) return RaiseError(AFX_ERR_ARG);
+    PyObject* list = PyList_New(0);
+    for (unsigned i = 0; list && i < info.lights; i++) {
+        afx_light_info light{sizeof(light)};
+        {
+            std::lock_guard<std::mutex> guard(*self->map->lock);
+            afx_get_light_info(self->map->ctx, self->index, i, &light);
+        }
+        PyObject* item =
+            Py_BuildValue("{s:I,s:I,s:I,s:s}", "id", light.id, "flags",
+                          light.flags, "scancode", light.scancode, "name",
+                          light.name);
+        if (!item || PyList_Append(list, item)) Py_CLEAR(list);
+        Py_XDECREF(item);
+    }
+    return list;
+}
+
+static PyObject* Functions_submit(Afx_pyFunctions* self, PyObject* args,
+                                  PyObject* kw) {
+    static const char* keys[]{"frame", "stride", nullptr};
+    Py_buffer view;
+    unsigned stride = 3;
+    if (!PyArg_ParseTupleAndKeywords(args, kw, "y*|I:submit", (char**)keys,
+                                     &view, &stride))
+        return nullptr;
+    // last color can go without padding
+    Py_ssize_t count = stride < 3 ? 0 : (view.len + stride - 3) / stride;
+    const char* error = nullptr;
+    if (stride < 3)
+        error = "stride should be 3 or more";
+    else if (view.len % stride && view.len % stride < 3)
+        error = "frame length is not a whole number of colors";
+    else if (count > 256)
+        error = "frame has more than 256 lights";
+    if (error) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, error);
+        return nullptr;
+    }
+    // buffer stays exported (and can't be resized) while it's read
+    int res;
+    {
+        Afx_pyNoGil nogil;
+        std::lock_guard<std::mutex> guard(*self->map->lock);
+        res = afx_submit_rgb(self->map->ctx, self->index,
+                             (const uint8_t*)view.buf, (unsigned)count,
+                             stride);
+    }
+    PyBuffer_Release(&view);
+    if (res < 0) return RaiseError(res);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Functions_set_brightness(Afx_pyFunctions* self,
+                                          PyObject* args) {
+    unsigned char br;
+    if (!PyArg_ParseTuple(args, "b:set_brightness", &br)) return nullptr;
+    int res;
+    {
+        Afx_pyNoGil nogil;
+        std::lock_guard<std::mutex> guard(*self->map->lock);
+        res = afx_set_brightness(self->map->ctx, self->index, br);
+    }
+    if (res < 0) return RaiseError(res);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Functions_repr(Afx_pyFunctions* self) {
+    afx_device_info info;
+    if (!GetInfo(self, info)) return PyUnicode_FromString("<Functions>");
+    return PyUnicode_FromFormat("<Functions %04x:%04x v%d '%s'>", info.vid,
+                                info.pid, info.api_version, info.name);
+}
+
+static PyMethodDef Functions_methods[]{
+    {"info", (PyCFunction)Functions_info, METH_NOARGS,
+     "Device information: IDs, API version, report length, lights,\n"
+     "AFX_CAP_* caps, present, reports sent and name"},
+    {"lights", (PyCFunction)Functions_lights, METH_NOARGS,
+     "Mapped lights: id, flags, scancode and name"},
+    {"submit", (PyCFunction)(void (*)())Functions_submit,
+     METH_VARARGS | METH_KEYWORDS,
+     "submit(frame, stride=3)\n"
+     "Show frame of RGB colors for light IDs 0..N-1. frame is any\n"
+     "contiguous buffer (bytes, bytearray, NumPy uint8 array of shape\n"
+     "(N, 3) or (N, 4) with stride=4), read in place without the GIL.\n"
+     "Only changed lights are sent, power button lights are skipped."},
+    {"set_brightness", (PyCFunction)Functions_set_brightness, METH_VARARGS,
+     "set_brightness(value)\nHardware brightness, 0..255"},
+    {nullptr}};
+
+// ----------- Control ------------
+
+static PyObject* Control_new(PyTypeObject* type, PyObject* args,
+                             PyObject* kw) {
+    if (!PyArg_ParseTuple(args, ":Control")) return nullptr;
+    auto* self = (Afx_pyControl*)type->tp_alloc(type, 0);
+    if (self) self->fan = new AlienFan_SDK::Control();
+    return (PyObject*)self;
+}
+
+static void Control_dealloc(Afx_pyControl* self) {
+    delete self->fan;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Control_probe(Afx_pyControl* self, PyObject*) {
+    bool res;
+    {
+        Afx_pyNoGil nogil;
+        res = self->fan->Probe();
+    }
+    return PyBool_FromLong(res);
+}
+
+// List of names of fans, sensors or profiles
+template <typename T>
+static PyObject* NameList(const std::vector<T>& items) {
+    PyObject* list = PyList_New(items.size());
+    for (size_t i = 0; list && i < items.size(); i++) {
+        PyObject* name = PyUnicode_FromString(items[i].name.c_str());
+        if (!name) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, name);
+    }
+    return list;
+}
+
+static PyObject* Control_fans(Afx_pyControl* self, PyObject*) {
+    return NameList(self->fan->fans);
+}
+
+static PyObject* Control_sensors(Afx_pyControl* self, PyObject*) {
+    return NameList(self->fan->sensors);
+}
+
+static PyObject* Control_profiles(Afx_pyControl* self, PyObject*) {
+    return NameList(self->fan->profiles);
+}
+
+// Fan index argument, NULL with IndexError if out of range
+static AlienFan_SDK::ALIENFAN_FAN* GetFan(Afx_pyControl* self, int id) {
+    if (id < 0 || id >= (int)self->fan->fans.size()) {
+        PyErr_SetString(PyExc_IndexError, "No such fan");
+        return nullptr;
+    }
+    return &self->fan->fans[id];
+}
+
+static PyObject* Control_fan_rpm(Afx_pyControl* self, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:fan_rpm", &id)) return nullptr;
+    auto* f = GetFan(self, id);
+    return f ? PyLong_FromLong(self->fan->GetFanRPM(*f)) : nullptr;
+}
+
+static PyObject* Control_fan_max_rpm(Afx_pyControl* self, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:fan_max_rpm", &id)) return nullptr;
+    auto* f = GetFan(self, id);
+    return f ? PyLong_FromLong(self->fan->GetMaxRPM(*f)) : nullptr;
+}
+
+static PyObject* Control_fan_percent(Afx_pyControl* self, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:fan_percent", &id)) return nullptr;
+    auto* f = GetFan(self, id);
+    return f ? PyLong_FromLong(self->fan->GetFanPercent(*f)) : nullptr;
+}
+
+static PyObject* Control_fan_boost(Afx_pyControl* self, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:fan_boost", &id)) return nullptr;
+    auto* f = GetFan(self, id);
+    return f ? PyLong_FromLong(self->fan->GetFanBoost(*f)) : nullptr;
+}
+
+static PyObject* Control_set_fan_boost(Afx_pyControl* self, PyObject* args) {
+    int id;
+    unsigned char value;
+    if (!PyArg_ParseTuple(args, "ib:set_fan_boost", &id, &value))
+        return nullptr;
+    auto* f = GetFan(self, id);
+    return f ? PyBool_FromLong(self->fan->SetFanBoost(*f, value)) : nullptr;
+}
+
+static PyObject* Control_temp(Afx_pyControl* self, PyObject* args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:temp", &id)) return nullptr;
+    if (id < 0 || id >= (int)self->fan->sensors.size()) {
+        PyErr_SetString(PyExc_IndexError, "No such sensor");
+        return nullptr;
+    }
+    return PyLong_FromLong(self->fan->GetTempValue(self->fan->sensors[id]));
+}
+
+static PyObject* Control_power_profile(Afx_pyControl* self, PyObject*) {
+    return PyUnicode_FromString(self->fan->GetPowerProfile().name.c_str());
+}
+
+static PyObject* Control_set_power_profile(Afx_pyControl* self,
+                                           PyObject* args) {
+    const char* name;
+    if (!PyArg_ParseTuple(args, "s:set_power_profile", &name)) return nullptr;
+    for (int i = 0; i <= AlienFan_SDK::LOW_POWER; i++)
+        if (!strcmp(name, AlienFan_SDK::ALIENFAN_PROFILE_NAME[i]))
+            return PyBool_FromLong(self->fan->SetPowerProfile(
+                (AlienFan_SDK::ALIENFAN_PROFILE)i));
+    PyErr_SetString(PyExc_ValueError, "Unknown profile");
+    return nullptr;
+}
+
+static PyObject* Control_gmode(Afx_pyControl* self, PyObject*) {
+    return PyBool_FromLong(self->fan->GetGMode());
+}
+
+static PyObject* Control_set_gmode(Afx_pyControl* self, PyObject* args) {
+    int state;
+    if (!PyArg_ParseTuple(args, "p:set_gmode", &state)) return nullptr;
+    return PyBool_FromLong(self->fan->SetGMode(state));
+}
+
+static PyMethodDef Control_methods[]{
+    {"probe", (PyCFunction)Control_probe, METH_NOARGS,
+     "Detect fans, sensors and power profiles, True if supported"},
+    {"fans", (PyCFunction)Control_fans, METH_NOARGS, "Fan names"},
+    {"sensors", (PyCFunction)Control_sensors, METH_NOARGS, "Sensor names"},
+    {"profiles", (PyCFunction)Control_profiles, METH_NOARGS,
+     "Supported power profile names"},
+    {"fan_rpm", (PyCFunction)Control_fan_rpm, METH_VARARGS,
+     "fan_rpm(fan)\nFan RPM"},
+    {"fan_max_rpm", (PyCFunction)Control_fan_max_rpm, METH_VARARGS,
+     "fan_max_rpm(fan)\nMaximal fan RPM"},
+    {"fan_percent", (PyCFunction)Control_fan_percent, METH_VARARGS,
+     "fan_percent(fan)\nFan RPM, percent of maximal"},
+    {"fan_boost", (PyCFunction)Control_fan_boost, METH_VARARGS,
+     "fan_boost(fan)\nFan boost"},
+    {"set_fan_boost", (PyCFunction)Control_set_fan_boost, METH_VARARGS,
+     "set_fan_boost(fan, value)\nSet fan boost, requires root"},
+    {"temp", (PyCFunction)Control_temp, METH_VARARGS,
+     "temp(sensor)\nSensor temperature, C"},
+    {"power_profile", (PyCFunction)Control_power_profile, METH_NOARGS,
+     "Current power profile name"},
+    {"set_power_profile", (PyCFunction)Control_set_power_profile,
+     METH_VARARGS, "set_power_profile(name)\nSet power profile, requires root"},
+    {"gmode", (PyCFunction)Control_gmode, METH_NOARGS, "G-mode state"},
+    {"set_gmode", (PyCFunction)Control_set_gmode, METH_VARARGS,
+     "set_gmode(state)\nToggle G-mode, requires root"},
+    {nullptr}};
+
+// ----------- Module ------------
+
+static PyModuleDef alienfxModule{
+    PyModuleDef_HEAD_INIT, "alienfx",
+    "AlienFX lights and AlienFan fans control", -1, nullptr};
+
+PyMODINIT_FUNC PyInit_alienfx(void) {
+    MappingsType.tp_name = "alienfx.Mappings";
+    MappingsType.tp_doc =
+        "Mappings()\nLoad mappings and open present light devices";
+    MappingsType.tp_basicsize = sizeof(Afx_pyMappings);
+    MappingsType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MappingsType.tp_new = Mappings_new;
+    MappingsType.tp_dealloc = (destructor)Mappings_dealloc;
+    MappingsType.tp_methods = Mappings_methods;
+
+    FunctionsType.tp_name = "alienfx.Functions";
+    FunctionsType.tp_doc = "Light device, from Mappings.devices()";
+    FunctionsType.tp_basicsize = sizeof(Afx_pyFunctions);
+    FunctionsType.tp_flags = Py_TPFLAGS_DEFAULT;
+    FunctionsType.tp_dealloc = (destructor)Functions_dealloc;
+    FunctionsType.tp_repr = (reprfunc)Functions_repr;
+    FunctionsType.tp_methods = Functions_methods;
+
+    ControlType.tp_name = "alienfx.Control";
+    ControlType.tp_doc = "Control()\nFans, sensors and power profiles";
+    ControlType.tp_basicsize = sizeof(Afx_pyControl);
+    ControlType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ControlType.tp_new = Control_new;
+    ControlType.tp_dealloc = (destructor)Control_dealloc;
+    ControlType.tp_methods = Control_methods;
+
+    if (PyType_Ready(&MappingsType) || PyType_Ready(&FunctionsType) ||
+        PyType_Ready(&ControlType))
+        return nullptr;
+    PyObject* m = PyModule_Create(&alienfxModule);
+    if (!m) return nullptr;
+    if (PyModule_AddObjectRef(m, "Mappings", (PyObject*)&MappingsType) ||
+        PyModule_AddObjectRef(m, "Functions", (PyObject*)&FunctionsType) ||
+        PyModule_AddObjectRef(m, "Control", (PyObject*)&ControlType) ||
+        PyModule_AddIntConstant(m, "CAP_COLOR", AFX_CAP_COLOR) ||
+        PyModule_AddIntConstant(m, "CAP_ACTIONS", AFX_CAP_ACTIONS) ||
+        PyModule_AddIntConstant(m, "CAP_GLOBAL", AFX_CAP_GLOBAL) ||
+        PyModule_AddIntConstant(m, "CAP_BRIGHTNESS", AFX_CAP_BRIGHTNESS) ||
+        PyModule_AddIntConstant(m, "CAP_SIMULATED", AFX_CAP_SIMULATED) ||
+        PyModule_AddIntConstant(m, "LIGHT_POWER", AFX_LIGHT_POWER) ||
+        PyModule_AddIntConstant(m, "LIGHT_INDICATOR", AFX_LIGHT_INDICATOR)) {
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}